@@ -6,8 +6,35 @@
 #include <thread>
 #include <atomic>
 #include <immintrin.h>
+#include <x86intrin.h>
 #include <functional>
+#include <mutex>
+#include <set>
+#include <optional>
+#include <complex>
+#include <chrono>
 #include <pybind11/numpy.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <filesystem>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace py = pybind11;
 
@@ -18,6 +45,403 @@ void AddToAtomic(std::atomic<double>& atomicValue, double valueToAdd){
     double currentValue = atomicValue.load();
     while(!atomicValue.compare_exchange_weak(currentValue,currentValue+valueToAdd));
 }
+//first line of a small /proc or /sys file, empty when it cannot be read
+std::string ReadFirstLine(const std::string& path){
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+std::string TrimField(const std::string& field){
+    size_t begin = field.find_first_not_of(" \t\r\"");
+    size_t end = field.find_last_not_of(" \t\r\"");
+    if(begin == std::string::npos){
+        return "";
+    }
+    return field.substr(begin, end - begin + 1);
+}
+
+//CPU limit from the cgroup quota, 0 when there is none. Checks the process' own cgroup first and
+//then the root of the mount, which is what a container sees when it has its own cgroup namespace
+int CgroupCpuLimit(){
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line, v2Path, v1Path;
+    while(std::getline(cgroups, line)){
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if(first == std::string::npos || second == std::string::npos){
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        if(controllers.empty()){
+            v2Path = path;
+        }else if(("," + controllers + ",").find(",cpu,") != std::string::npos){
+            v1Path = path;
+        }
+    }
+    auto ceilQuota = [](double quota, double period){
+        return quota > 0 && period > 0 ? std::max(1, static_cast<int>(std::ceil(quota / period))) : 0;
+    };
+    //cgroup v2: "<quota> <period>" or "max <period>"
+    for(const std::string& directory : {"/sys/fs/cgroup" + v2Path, std::string("/sys/fs/cgroup")}){
+        std::string cpuMax = ReadFirstLine(directory + "/cpu.max");
+        if(cpuMax.empty()){
+            continue;
+        }
+        if(cpuMax.compare(0, 3, "max") == 0){
+            return 0;
+        }
+        double quota = 0, period = 0;
+        if(std::sscanf(cpuMax.c_str(), "%lf %lf", &quota, &period) == 2){
+            return ceilQuota(quota, period);
+        }
+    }
+    //cgroup v1: quota of -1 means unlimited
+    for(const std::string& directory : {"/sys/fs/cgroup/cpu,cpuacct" + v1Path, "/sys/fs/cgroup/cpu" + v1Path,
+                                        std::string("/sys/fs/cgroup/cpu,cpuacct"), std::string("/sys/fs/cgroup/cpu")}){
+        std::string quota = ReadFirstLine(directory + "/cpu.cfs_quota_us");
+        std::string period = ReadFirstLine(directory + "/cpu.cfs_period_us");
+        if(!quota.empty() && !period.empty()){
+            return ceilQuota(std::atof(quota.c_str()), std::atof(period.c_str()));
+        }
+    }
+    return 0;
+}
+
+//threads this process can actually run at once: hardware_concurrency capped by the affinity mask
+//and the cgroup CPU quota, so a pod limited to 8 CPUs on a 96 CPU host gets 8
+int AvailableThreadCount(){
+    static const int available = [](){
+        int count = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t affinity;
+        CPU_ZERO(&affinity);
+        if(sched_getaffinity(0, sizeof(affinity), &affinity) == 0){
+            count = std::min(count, std::max(1, CPU_COUNT(&affinity)));
+        }
+        int quota = CgroupCpuLimit();
+        if(quota > 0){
+            count = std::min(count, quota);
+        }
+        return count;
+    }();
+    return available;
+}
+
+//numThreads <= 0 means use every available CPU, never more threads than work items
+int ResolveThreadCount(int numThreads, long long workItems = std::numeric_limits<long long>::max()){
+    int count = numThreads > 0 ? numThreads : AvailableThreadCount();
+    return static_cast<int>(std::max(1LL, std::min<long long>(count, workItems)));
+}
+
+//hardware counters summed over every worker of one engine run, NaN for events the machine or the
+//perf_event_paranoid setting does not allow
+struct PerfCounterTotals{
+    static constexpr int numEvents = 8;
+    static const char* const names[numEvents];
+    std::mutex mutex;
+    int workers = 0;
+    double values[numEvents] = {};
+    bool opened[numEvents] = {};
+
+    void Add(const double* counts, const bool* valid){
+        std::lock_guard<std::mutex> lock(mutex);
+        ++workers;
+        for(int e=0; e<numEvents; ++e){
+            values[e] += valid[e] ? counts[e] : 0.0;
+            opened[e] = opened[e] || valid[e];
+        }
+    }
+};
+const char* const PerfCounterTotals::names[PerfCounterTotals::numEvents] = {
+    "cycles", "instructions", "cacheReferences", "cacheMisses", "branchMisses",
+    "fpScalarDouble", "fp256PackedDouble", "fp512PackedDouble"
+};
+
+//opens a counter group for the calling thread (user space only) on construction and adds the
+//counts to totals on destruction, does nothing when totals is null
+class ScopedPerfCounters{
+public:
+    explicit ScopedPerfCounters(PerfCounterTotals* totals) : totals(totals) {
+        if(!totals){
+            return;
+        }
+        //FP_ARITH_INST_RETIRED umasks, these raw encodings only exist on Intel cores
+        bool intel = __builtin_cpu_is("intel");
+        const std::pair<uint32_t, uint64_t> events[PerfCounterTotals::numEvents] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_RAW, 0x01C7},
+            {PERF_TYPE_RAW, 0x10C7},
+            {PERF_TYPE_RAW, 0x40C7},
+        };
+        for(int e=0; e<PerfCounterTotals::numEvents; ++e){
+            fds[e] = -1;
+            if(events[e].first == PERF_TYPE_RAW && !intel){
+                continue;
+            }
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[e].first;
+            attr.config = events[e].second;
+            attr.disabled = leader < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if(fd < 0 && leader >= 0){
+                //the PMU may not fit every event in one group, count it on its own instead
+                attr.disabled = 1;
+                fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+                if(fd >= 0){
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+            if(fd >= 0 && leader < 0){
+                leader = fd;
+            }
+            fds[e] = fd;
+        }
+        if(leader >= 0){
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    ~ScopedPerfCounters(){
+        if(!totals){
+            return;
+        }
+        if(leader >= 0){
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+        double counts[PerfCounterTotals::numEvents] = {};
+        bool valid[PerfCounterTotals::numEvents] = {};
+        for(int e=0; e<PerfCounterTotals::numEvents; ++e){
+            if(fds[e] < 0){
+                continue;
+            }
+            //value, time enabled, time running: scaled up when the kernel had to multiplex the counter
+            uint64_t data[3] = {0, 0, 0};
+            if(read(fds[e], data, sizeof(data)) == static_cast<ssize_t>(sizeof(data)) && data[2] > 0){
+                counts[e] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+                valid[e] = true;
+            }
+            close(fds[e]);
+        }
+        totals->Add(counts, valid);
+    }
+
+    ScopedPerfCounters(const ScopedPerfCounters&) = delete;
+    ScopedPerfCounters& operator=(const ScopedPerfCounters&) = delete;
+
+private:
+    PerfCounterTotals* totals;
+    int leader = -1;
+    int fds[PerfCounterTotals::numEvents];
+};
+
+//Opt-in timeline of engine phases written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+//Every thread records complete events into its own ring buffer with a single writer and no locks,
+//the oldest events are overwritten when it is full. Buffers outlive their threads and are handed to
+//the next thread that starts, so each trace row is a worker slot rather than one OS thread.
+//Only the owning thread ever resizes or clears its buffer: Enable just bumps a generation and the owner catches up on
+//its next Record, so enabling from another python thread while an engine runs never frees storage in use
+struct TraceEvent{
+    const char* name;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+struct TraceBuffer{
+    int slot;
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> generation{0};
+};
+
+class Tracer{
+public:
+    static Tracer& Instance(){
+        static Tracer tracer;
+        return tracer;
+    }
+
+    bool Enabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Now() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    //capacity is rounded up to a power of two, enabling again clears earlier events (each buffer when its owner
+    //next records, Dump skips buffers that have not caught up yet)
+    void Enable(size_t capacity){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t rounded = 1;
+            while(rounded < capacity){
+                rounded <<= 1;
+            }
+            bufferCapacity = rounded;
+            generation.fetch_add(1, std::memory_order_release);
+        }
+        Refresh(ThreadBuffer());
+        enabled = true;
+    }
+
+    void Disable(){
+        enabled = false;
+    }
+
+    void Record(const char* name, uint64_t beginNs, uint64_t endNs){
+        TraceBuffer* buffer = ThreadBuffer();
+        if(buffer->generation.load(std::memory_order_relaxed) != generation.load(std::memory_order_acquire)){
+            Refresh(buffer);
+        }
+        uint64_t index = buffer->head.load(std::memory_order_relaxed);
+        buffer->events[index & (buffer->events.size() - 1)] = TraceEvent{name, beginNs, endNs};
+        buffer->head.store(index + 1, std::memory_order_release);
+    }
+
+    //meant to be called while no engine is running, events written during the dump may be torn
+    bool Dump(const std::string& path){
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ofstream out(path, std::ios::trunc);
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        bool first = true;
+        uint64_t current = generation.load(std::memory_order_acquire);
+        for(const auto& buffer : buffers){
+            if(buffer->generation.load(std::memory_order_relaxed) != current){
+                continue;
+            }
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->slot
+                << ",\"args\":{\"name\":\"" << (buffer->slot == 0 ? "caller" : "worker " + std::to_string(buffer->slot)) << "\"}}";
+            first = false;
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t size = buffer->events.size();
+            for(uint64_t i = head > size ? head - size : 0; i < head; ++i){
+                const TraceEvent& event = buffer->events[i & (size - 1)];
+                if(!event.name){
+                    continue;
+                }
+                char line[256];
+                std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                              event.name, buffer->slot, event.beginNs / 1000.0, (event.endNs - event.beginNs) / 1000.0);
+                out << line;
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    //returns the buffer to the free list when the thread exits
+    struct ThreadSlot{
+        TraceBuffer* buffer = nullptr;
+        ~ThreadSlot(){
+            if(buffer){
+                Tracer::Instance().Release(buffer);
+            }
+        }
+    };
+
+    TraceBuffer* ThreadBuffer(){
+        static thread_local ThreadSlot slot;
+        if(!slot.buffer){
+            slot.buffer = Acquire();
+        }
+        return slot.buffer;
+    }
+
+    //Enable claims a buffer first, so slot 0 is the thread that enabled tracing, normally the python caller
+    TraceBuffer* Acquire(){
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!freeBuffers.empty()){
+            TraceBuffer* buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+            return buffer;
+        }
+        buffers.push_back(std::make_unique<TraceBuffer>());
+        TraceBuffer* buffer = buffers.back().get();
+        buffer->slot = static_cast<int>(buffers.size()) - 1;
+        buffer->events.assign(bufferCapacity, TraceEvent{nullptr, 0, 0});
+        buffer->generation.store(generation.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return buffer;
+    }
+
+    //called by the buffer's owner only: clears it and applies the capacity of the latest Enable
+    void Refresh(TraceBuffer* buffer){
+        std::lock_guard<std::mutex> lock(mutex);
+        if(buffer->events.size() != bufferCapacity){
+            buffer->events.assign(bufferCapacity, TraceEvent{nullptr, 0, 0});
+        }else{
+            std::fill(buffer->events.begin(), buffer->events.end(), TraceEvent{nullptr, 0, 0});
+        }
+        buffer->head.store(0, std::memory_order_relaxed);
+        buffer->generation.store(generation.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    void Release(TraceBuffer* buffer){
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(buffer);
+    }
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::atomic<uint64_t> generation{0};
+    size_t bufferCapacity = 1 << 16;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::vector<TraceBuffer*> freeBuffers;
+};
+
+//records [construction, destruction) under name when tracing is on, name must be a string literal
+class TraceScope{
+public:
+    explicit TraceScope(const char* name) : name(Tracer::Instance().Enabled() ? name : nullptr), beginNs(this->name ? Tracer::Instance().Now() : 0) {}
+    ~TraceScope(){
+        if(name){
+            Tracer::Instance().Record(name, beginNs, Tracer::Instance().Now());
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t beginNs;
+};
+
+//py::gil_scoped_release that also traces how long the GIL was released and how long taking it back took
+class TracedGILRelease{
+public:
+    TracedGILRelease() : beginNs(Tracer::Instance().Now()) {
+        release.emplace();
+    }
+    ~TracedGILRelease(){
+        uint64_t acquireNs = Tracer::Instance().Now();
+        release.reset();
+        if(Tracer::Instance().Enabled()){
+            Tracer::Instance().Record("gilReleased", beginNs, acquireNs);
+            Tracer::Instance().Record("gilAcquire", acquireNs, Tracer::Instance().Now());
+        }
+    }
+    TracedGILRelease(const TracedGILRelease&) = delete;
+    TracedGILRelease& operator=(const TracedGILRelease&) = delete;
+
+private:
+    uint64_t beginNs;
+    std::optional<py::gil_scoped_release> release;
+};
+
 //SIMD custom function for computing exponential function fitted to range (-0.2,0.2)
 //error compared to STD::EXP() over same range ~ (7.5E-09:3.1E-10)
 __m256d exp_approx(__m256d x) {
@@ -43,7 +467,8 @@ __m256d exp_approx(__m256d x) {
     return result;
 }
 void simulatePaths(int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT,
-                   std::atomic<double>& totalAverage, std::vector<std::vector<double>>& displayPaths, bool collectDisplayPaths)
+                   std::atomic<double>& totalAverage, std::vector<std::vector<double>>& displayPaths, bool collectDisplayPaths,
+                   PerfCounterTotals* counters = nullptr)
 {
     std::vector<std::vector<double>> localDisplayPaths;
     double sumFinalPrices = 0.0;
@@ -51,6 +476,8 @@ void simulatePaths(int numPaths, int steps, double startingPrice, double partial
     std::mt19937 gen(rd());
     std::normal_distribution<double> d(0.0,1.0);
     
+    ScopedPerfCounters perfCounters(counters);
+    TraceScope trace("simulatePaths");
     for(int i=0; i<numPaths; ++i){
         std::vector<double> path(steps, startingPrice);
         double price = startingPrice;
@@ -117,7 +544,7 @@ double CalculateSIMDPaths(int numPaths, int steps, double startingPrice, double
         }
         _mm256_storeu_pd(finalPrices,_prices);
         double averageForThisPass = 0;
-        for(int k=0;k<4;k++){
+        for(int k=0;k<4 && i+k<numPaths;k++){
             averageForThisPass+=finalPrices[k];
         }
         averageForThisThread+= (averageForThisPass);
@@ -125,7 +552,580 @@ double CalculateSIMDPaths(int numPaths, int steps, double startingPrice, double
     return averageForThisThread / numPaths;
 }
 
-std::pair<std::vector<std::vector<double>>, double> SimulateGBMMultiThreaded(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int totalPaths) {
+//Same recurrence as CalculateSIMDPaths but with Streams independent groups of 4 paths in flight.
+//A single __m256d forms one serial chain (fmadd -> exp_approx -> mul) per step, so the core waits on
+//latency; interleaving the chains lets their instructions overlap. Normals for step j+1 are drawn
+//before the arithmetic of step j so the RNG work also overlaps the exp chains
+template<int Streams>
+double CalculateSIMDPathsInterleaved(int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT)
+{
+    constexpr int lanes = 4 * Streams;
+    __m256d _a = _mm256_mul_pd(_mm256_set1_pd(normalizedStd),_mm256_set1_pd(sqrtDeltaT));
+    __m256d _partialCompVec = _mm256_set1_pd(partialComputation);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<double> d(0.0,1.0);
+    double sumFinalPrices = 0;
+
+    int blockedPaths = numPaths - numPaths % lanes;
+    for(int i=0; i<blockedPaths; i+=lanes){
+        __m256d _prices[Streams];
+        for(int s=0; s<Streams; ++s){
+            _prices[s] = _mm256_set1_pd(startingPrice);
+        }
+        alignas(32) double ranNums[2][lanes];
+        for(int k=0; k<lanes; ++k){
+            ranNums[0][k] = d(gen);
+        }
+        for(int j=1; j<steps; ++j){
+            const double* current = ranNums[(j - 1) & 1];
+            double* next = ranNums[j & 1];
+            if(j + 1 < steps){
+                for(int k=0; k<lanes; ++k){
+                    next[k] = d(gen);
+                }
+            }
+            for(int s=0; s<Streams; ++s){
+                __m256d _c = _mm256_fmadd_pd(_a,_mm256_load_pd(current + 4 * s),_partialCompVec);
+                _prices[s] = _mm256_mul_pd(_prices[s],exp_approx(_c));
+            }
+        }
+        __m256d _sum = _prices[0];
+        for(int s=1; s<Streams; ++s){
+            _sum = _mm256_add_pd(_sum,_prices[s]);
+        }
+        alignas(32) double finalPrices[4];
+        _mm256_store_pd(finalPrices,_sum);
+        sumFinalPrices += finalPrices[0] + finalPrices[1] + finalPrices[2] + finalPrices[3];
+    }
+    //leftover paths one group of 4 at a time, lanes past numPaths are not summed
+    for(int i=blockedPaths; i<numPaths; i+=4){
+        __m256d _prices = _mm256_set1_pd(startingPrice);
+        for(int j=1; j<steps; ++j){
+            alignas(32) double ranNums[4];
+            for(int k=0; k<4; ++k){
+                ranNums[k] = d(gen);
+            }
+            __m256d _c = _mm256_fmadd_pd(_a,_mm256_load_pd(ranNums),_partialCompVec);
+            _prices = _mm256_mul_pd(_prices,exp_approx(_c));
+        }
+        alignas(32) double finalPrices[4];
+        _mm256_store_pd(finalPrices,_prices);
+        for(int k=0; k<4 && i+k<numPaths; ++k){
+            sumFinalPrices += finalPrices[k];
+        }
+    }
+    return numPaths > 0 ? sumFinalPrices / numPaths : 0.0;
+}
+
+//splitmix64 finaliser, turns (seed, index) pairs into well mixed independent seeds
+uint64_t MixSeed(uint64_t value){
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+//seed of a second generator running next to one seeded with seed. SIMDNormalGenerator fills its lanes by chaining
+//MixSeed from the seed, so MixSeed(seed) itself would reproduce the same lane streams shifted by one lane
+uint64_t SubstreamSeed(uint64_t seed, uint64_t stream){
+    return MixSeed(seed ^ MixSeed(0xD1B54A32D192ED03ULL * (stream + 1)));
+}
+
+//natural log for positive, finite, normal x: exponent from the bits, mantissa reduced to [sqrt(1/2), sqrt(2))
+//and ln(m) = 2 atanh((m - 1) / (m + 1)) as an odd series, relative error below 1E-12
+__m256d log_approx(__m256d x) {
+    const __m256i _mantissaMask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m256i _one = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    __m256i _bits = _mm256_castpd_si256(x);
+    __m256d _m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(_bits,_mantissaMask),_one));
+    //biased exponent as a double via the 2^52 trick (AVX2 has no int64 -> double conversion)
+    __m256i _biased = _mm256_srli_epi64(_bits,52);
+    __m256d _magic = _mm256_set1_pd(4503599627370496.0);
+    __m256d _e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_biased,_mm256_castpd_si256(_magic))),_magic);
+    _e = _mm256_sub_pd(_e,_mm256_set1_pd(1023.0));
+    __m256d _large = _mm256_cmp_pd(_m,_mm256_set1_pd(1.4142135623730951),_CMP_GT_OQ);
+    _m = _mm256_blendv_pd(_m,_mm256_mul_pd(_m,_mm256_set1_pd(0.5)),_large);
+    _e = _mm256_add_pd(_e,_mm256_and_pd(_large,_mm256_set1_pd(1.0)));
+
+    __m256d _t = _mm256_div_pd(_mm256_sub_pd(_m,_mm256_set1_pd(1.0)),_mm256_add_pd(_m,_mm256_set1_pd(1.0)));
+    __m256d _t2 = _mm256_mul_pd(_t,_t);
+    __m256d _series = _mm256_set1_pd(1.0 / 15);
+    _series = _mm256_fmadd_pd(_series,_t2,_mm256_set1_pd(1.0 / 13));
+    _series = _mm256_fmadd_pd(_series,_t2,_mm256_set1_pd(1.0 / 11));
+    _series = _mm256_fmadd_pd(_series,_t2,_mm256_set1_pd(1.0 / 9));
+    _series = _mm256_fmadd_pd(_series,_t2,_mm256_set1_pd(1.0 / 7));
+    _series = _mm256_fmadd_pd(_series,_t2,_mm256_set1_pd(1.0 / 5));
+    _series = _mm256_fmadd_pd(_series,_t2,_mm256_set1_pd(1.0 / 3));
+    _series = _mm256_fmadd_pd(_series,_t2,_mm256_set1_pd(1.0));
+    __m256d _logM = _mm256_mul_pd(_mm256_mul_pd(_t,_series),_mm256_set1_pd(2.0));
+    return _mm256_fmadd_pd(_e,_mm256_set1_pd(0.6931471805599453),_logM);
+}
+
+//sin and cos of 2*pi*u for u in [0,1): quadrant from 4u, the remaining angle is centred on pi/4 so the
+//Taylor series only sees |x| <= pi/4, error below 1E-11
+void sincos_2pi_approx(__m256d u, __m256d& sinOut, __m256d& cosOut) {
+    __m256d _scaled = _mm256_mul_pd(u,_mm256_set1_pd(4.0));
+    __m256d _quadrant = _mm256_floor_pd(_scaled);
+    __m256d _x = _mm256_mul_pd(_mm256_sub_pd(_scaled,_quadrant),_mm256_set1_pd(1.5707963267948966));
+    _x = _mm256_sub_pd(_x,_mm256_set1_pd(0.7853981633974483));
+    __m256d _x2 = _mm256_mul_pd(_x,_x);
+    __m256d _sin = _mm256_set1_pd(-1.0 / 39916800);
+    _sin = _mm256_fmadd_pd(_sin,_x2,_mm256_set1_pd(1.0 / 362880));
+    _sin = _mm256_fmadd_pd(_sin,_x2,_mm256_set1_pd(-1.0 / 5040));
+    _sin = _mm256_fmadd_pd(_sin,_x2,_mm256_set1_pd(1.0 / 120));
+    _sin = _mm256_fmadd_pd(_sin,_x2,_mm256_set1_pd(-1.0 / 6));
+    _sin = _mm256_fmadd_pd(_sin,_x2,_mm256_set1_pd(1.0));
+    _sin = _mm256_mul_pd(_sin,_x);
+    __m256d _cos = _mm256_set1_pd(1.0 / 479001600);
+    _cos = _mm256_fmadd_pd(_cos,_x2,_mm256_set1_pd(-1.0 / 3628800));
+    _cos = _mm256_fmadd_pd(_cos,_x2,_mm256_set1_pd(1.0 / 40320));
+    _cos = _mm256_fmadd_pd(_cos,_x2,_mm256_set1_pd(-1.0 / 720));
+    _cos = _mm256_fmadd_pd(_cos,_x2,_mm256_set1_pd(1.0 / 24));
+    _cos = _mm256_fmadd_pd(_cos,_x2,_mm256_set1_pd(-0.5));
+    _cos = _mm256_fmadd_pd(_cos,_x2,_mm256_set1_pd(1.0));
+    //undo the pi/4 shift: sin(x + pi/4) = (sin + cos) / sqrt(2), cos(x + pi/4) = (cos - sin) / sqrt(2)
+    __m256d _rootHalf = _mm256_set1_pd(0.7071067811865476);
+    __m256d _s = _mm256_mul_pd(_mm256_add_pd(_sin,_cos),_rootHalf);
+    __m256d _c = _mm256_mul_pd(_mm256_sub_pd(_cos,_sin),_rootHalf);
+    //rotate by the quadrant: 1 -> (c, -s), 2 -> (-s, -c), 3 -> (-c, s) as (sin, cos)
+    __m256d _negS = _mm256_sub_pd(_mm256_setzero_pd(),_s);
+    __m256d _negC = _mm256_sub_pd(_mm256_setzero_pd(),_c);
+    __m256d _q1 = _mm256_cmp_pd(_quadrant,_mm256_set1_pd(1.0),_CMP_EQ_OQ);
+    __m256d _q2 = _mm256_cmp_pd(_quadrant,_mm256_set1_pd(2.0),_CMP_EQ_OQ);
+    __m256d _q3 = _mm256_cmp_pd(_quadrant,_mm256_set1_pd(3.0),_CMP_EQ_OQ);
+    sinOut = _mm256_blendv_pd(_mm256_blendv_pd(_mm256_blendv_pd(_s,_c,_q1),_negS,_q2),_negC,_q3);
+    cosOut = _mm256_blendv_pd(_mm256_blendv_pd(_mm256_blendv_pd(_c,_negS,_q1),_negC,_q2),_s,_q3);
+}
+
+//exp over the whole double range: x = n ln2 + r with |r| <= ln2 / 2, a degree 11 Taylor polynomial for e^r and
+//2^n built in the exponent bits, relative error below 1E-14. Unlike exp_approx it is not limited to small steps
+__m256d exp_full_approx(__m256d x) {
+    x = _mm256_max_pd(_mm256_min_pd(x,_mm256_set1_pd(708.0)),_mm256_set1_pd(-708.0));
+    __m256d _n = _mm256_round_pd(_mm256_mul_pd(x,_mm256_set1_pd(1.4426950408889634)),_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    //ln2 split in two so n * ln2Hi is exact
+    __m256d _r = _mm256_fnmadd_pd(_n,_mm256_set1_pd(0.6931471803691238),x);
+    _r = _mm256_fnmadd_pd(_n,_mm256_set1_pd(1.9082149292705877E-10),_r);
+    __m256d _p = _mm256_set1_pd(1.0 / 39916800);
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 3628800));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 362880));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 40320));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 5040));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 720));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 120));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 24));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0 / 6));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(0.5));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0));
+    _p = _mm256_fmadd_pd(_p,_r,_mm256_set1_pd(1.0));
+    __m256i _exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(_n));
+    __m256i _scale = _mm256_slli_epi64(_mm256_add_epi64(_exponent,_mm256_set1_epi64x(1023)),52);
+    return _mm256_mul_pd(_p,_mm256_castsi256_pd(_scale));
+}
+
+//standard normal cdf, Zelen & Severo (Abramowitz and Stegun 26.2.17), absolute error below 7.5E-8
+__m256d normcdf_approx(__m256d x) {
+    __m256d _z = _mm256_andnot_pd(_mm256_set1_pd(-0.0),x);
+    __m256d _t = _mm256_div_pd(_mm256_set1_pd(1.0),_mm256_fmadd_pd(_z,_mm256_set1_pd(0.2316419),_mm256_set1_pd(1.0)));
+    __m256d _poly = _mm256_set1_pd(1.330274429);
+    _poly = _mm256_fmadd_pd(_poly,_t,_mm256_set1_pd(-1.821255978));
+    _poly = _mm256_fmadd_pd(_poly,_t,_mm256_set1_pd(1.781477937));
+    _poly = _mm256_fmadd_pd(_poly,_t,_mm256_set1_pd(-0.356563782));
+    _poly = _mm256_fmadd_pd(_poly,_t,_mm256_set1_pd(0.319381530));
+    _poly = _mm256_mul_pd(_poly,_t);
+    __m256d _density = _mm256_mul_pd(exp_full_approx(_mm256_mul_pd(_mm256_mul_pd(_z,_z),_mm256_set1_pd(-0.5))),_mm256_set1_pd(0.3989422804014327));
+    __m256d _tail = _mm256_mul_pd(_density,_poly);
+    return _mm256_blendv_pd(_tail,_mm256_sub_pd(_mm256_set1_pd(1.0),_tail),_mm256_cmp_pd(x,_mm256_setzero_pd(),_CMP_GT_OQ));
+}
+
+//four independent xoshiro256+ generators, one per 64 bit lane, with Box-Muller on top so whole
+//blocks of normals are produced without the branches of std::normal_distribution
+struct SIMDNormalGenerator{
+    __m256i s0, s1, s2, s3;
+
+    explicit SIMDNormalGenerator(uint64_t seed){
+        alignas(32) uint64_t state[4][4];
+        uint64_t value = seed;
+        for(int w=0; w<4; ++w){
+            for(int lane=0; lane<4; ++lane){
+                value = MixSeed(value);
+                state[w][lane] = value;
+            }
+        }
+        s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[0]));
+        s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[1]));
+        s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[2]));
+        s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[3]));
+    }
+
+    __m256i NextBits(){
+        __m256i result = _mm256_add_epi64(s0,s3);
+        __m256i t = _mm256_slli_epi64(s1,17);
+        s2 = _mm256_xor_si256(s2,s0);
+        s3 = _mm256_xor_si256(s3,s1);
+        s1 = _mm256_xor_si256(s1,s2);
+        s0 = _mm256_xor_si256(s0,s3);
+        s2 = _mm256_xor_si256(s2,t);
+        s3 = _mm256_or_si256(_mm256_slli_epi64(s3,45),_mm256_srli_epi64(s3,19));
+        return result;
+    }
+
+    //uniform in [0,1) from the top 52 bits
+    __m256d NextUniform(){
+        __m256i bits = _mm256_or_si256(_mm256_srli_epi64(NextBits(),12),_mm256_set1_epi64x(0x3FF0000000000000LL));
+        return _mm256_sub_pd(_mm256_castsi256_pd(bits),_mm256_set1_pd(1.0));
+    }
+
+    //count must be a multiple of 8 and out 32 byte aligned
+    void Fill(double* out, size_t count){
+        for(size_t i=0; i<count; i+=8){
+            //1 - u keeps the radius argument in (0,1] so the log never sees zero
+            __m256d _u1 = _mm256_sub_pd(_mm256_set1_pd(1.0),NextUniform());
+            __m256d _u2 = NextUniform();
+            __m256d _radius = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_set1_pd(-2.0),log_approx(_u1)));
+            __m256d _sin, _cos;
+            sincos_2pi_approx(_u2,_sin,_cos);
+            _mm256_store_pd(out + i,_mm256_mul_pd(_radius,_cos));
+            _mm256_store_pd(out + i + 4,_mm256_mul_pd(_radius,_sin));
+        }
+    }
+};
+
+//default number of steps per RNG tile, 128 steps x 16 lanes x 8 bytes = 16KB so the tile sits in L1
+std::atomic<int> rngBlockSteps(128);
+
+//two phase version of the SIMD recurrence: a steps x 16 lane tile of normals is generated with the
+//vectorised generator, then 4 interleaved groups of 4 paths run pure arithmetic over the tile
+double CalculateSIMDPathsBlockRNG(int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT, int blockSteps)
+{
+    constexpr int streams = 4;
+    constexpr int lanes = 4 * streams;
+    blockSteps = std::max(1, blockSteps);
+    __m256d _a = _mm256_mul_pd(_mm256_set1_pd(normalizedStd),_mm256_set1_pd(sqrtDeltaT));
+    __m256d _partialCompVec = _mm256_set1_pd(partialComputation);
+    std::random_device rd;
+    SIMDNormalGenerator generator((static_cast<uint64_t>(rd()) << 32) | rd());
+    std::vector<double> storage(static_cast<size_t>(blockSteps) * lanes + 4);
+    //manual 32 byte alignment of the tile inside the vector
+    double* tile = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+    double sumFinalPrices = 0;
+
+    for(int i=0; i<numPaths; i+=lanes){
+        __m256d _prices[streams];
+        for(int s=0; s<streams; ++s){
+            _prices[s] = _mm256_set1_pd(startingPrice);
+        }
+        for(int blockStart=1; blockStart<steps; blockStart+=blockSteps){
+            int blockLength = std::min(blockSteps, steps - blockStart);
+            {
+                TraceScope trace("rngBlock");
+                generator.Fill(tile, static_cast<size_t>(blockLength) * lanes);
+            }
+            TraceScope trace("priceUpdate");
+            for(int j=0; j<blockLength; ++j){
+                const double* ranNums = tile + j * lanes;
+                for(int s=0; s<streams; ++s){
+                    __m256d _c = _mm256_fmadd_pd(_a,_mm256_load_pd(ranNums + 4 * s),_partialCompVec);
+                    _prices[s] = _mm256_mul_pd(_prices[s],exp_approx(_c));
+                }
+            }
+        }
+        alignas(32) double finalPrices[lanes];
+        for(int s=0; s<streams; ++s){
+            _mm256_store_pd(finalPrices + 4 * s,_prices[s]);
+        }
+        for(int k=0; k<lanes && i+k<numPaths; ++k){
+            sumFinalPrices += finalPrices[k];
+        }
+    }
+    return numPaths > 0 ? sumFinalPrices / numPaths : 0.0;
+}
+
+double CalculateSIMDPathsBlockRNGDefault(int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT){
+    return CalculateSIMDPathsBlockRNG(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, rngBlockSteps.load());
+}
+
+//exp_approx on 8 lanes, same coefficients and range
+__attribute__((target("avx512f")))
+__m512d exp_approx512(__m512d x) {
+    __m512d c0 = _mm512_set1_pd(1);
+    __m512d c1 = _mm512_set1_pd(1);
+    __m512d c2 = _mm512_set1_pd(0.49999898);
+    __m512d c3 = _mm512_set1_pd(0.16666646);
+    __m512d c4 = _mm512_set1_pd(0.04174285);
+    __m512d c5 = _mm512_set1_pd(0.00834562);
+
+    __m512d x2 = _mm512_mul_pd(x, x);
+    __m512d x3 = _mm512_mul_pd(x2, x);
+    __m512d x4 = _mm512_mul_pd(x2, x2);
+    __m512d x5 = _mm512_mul_pd(x3, x2);
+
+    __m512d result = _mm512_add_pd(c0, _mm512_mul_pd(c1, x));
+    result = _mm512_add_pd(result, _mm512_mul_pd(c2, x2));
+    result = _mm512_add_pd(result, _mm512_mul_pd(c3, x3));
+    result = _mm512_add_pd(result, _mm512_mul_pd(c4, x4));
+    result = _mm512_add_pd(result, _mm512_mul_pd(c5, x5));
+
+    return result;
+}
+
+bool HasAVX512(){
+    return __builtin_cpu_supports("avx512f");
+}
+
+//CalculateSIMDPathsBlockRNG with the price update on 4 interleaved groups of 8 paths in AVX-512
+//registers, the tile is still filled by the AVX2 generator. Only call when HasAVX512()
+__attribute__((target("avx512f")))
+double CalculateSIMDPathsBlockRNG512(int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT, int blockSteps)
+{
+    constexpr int streams = 4;
+    constexpr int lanes = 8 * streams;
+    blockSteps = std::max(1, blockSteps);
+    __m512d _a = _mm512_mul_pd(_mm512_set1_pd(normalizedStd),_mm512_set1_pd(sqrtDeltaT));
+    __m512d _partialCompVec = _mm512_set1_pd(partialComputation);
+    std::random_device rd;
+    SIMDNormalGenerator generator((static_cast<uint64_t>(rd()) << 32) | rd());
+    std::vector<double> storage(static_cast<size_t>(blockSteps) * lanes + 8);
+    double* tile = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~static_cast<uintptr_t>(63));
+    double sumFinalPrices = 0;
+
+    for(int i=0; i<numPaths; i+=lanes){
+        __m512d _prices[streams];
+        for(int s=0; s<streams; ++s){
+            _prices[s] = _mm512_set1_pd(startingPrice);
+        }
+        for(int blockStart=1; blockStart<steps; blockStart+=blockSteps){
+            int blockLength = std::min(blockSteps, steps - blockStart);
+            {
+                TraceScope trace("rngBlock");
+                generator.Fill(tile, static_cast<size_t>(blockLength) * lanes);
+            }
+            TraceScope trace("priceUpdate");
+            for(int j=0; j<blockLength; ++j){
+                const double* ranNums = tile + j * lanes;
+                for(int s=0; s<streams; ++s){
+                    __m512d _c = _mm512_fmadd_pd(_a,_mm512_load_pd(ranNums + 8 * s),_partialCompVec);
+                    _prices[s] = _mm512_mul_pd(_prices[s],exp_approx512(_c));
+                }
+            }
+        }
+        alignas(64) double finalPrices[lanes];
+        for(int s=0; s<streams; ++s){
+            _mm512_store_pd(finalPrices + 8 * s,_prices[s]);
+        }
+        for(int k=0; k<lanes && i+k<numPaths; ++k){
+            sumFinalPrices += finalPrices[k];
+        }
+    }
+    return numPaths > 0 ? sumFinalPrices / numPaths : 0.0;
+}
+
+using SIMDKernel = std::function<double(int, int, double, double, double, double)>;
+
+SIMDKernel InterleavedKernel(int streams){
+    switch(streams){
+        case 1: return CalculateSIMDPaths;
+        case 2: return CalculateSIMDPathsInterleaved<2>;
+        case 3: return CalculateSIMDPathsInterleaved<3>;
+        case 4: return CalculateSIMDPathsInterleaved<4>;
+        default: throw std::invalid_argument("streams must be between 1 and 4");
+    }
+}
+
+//per machine engine configuration written by Autotune, a profile is only used on the machine it was
+//made on (same CPU model and available thread count)
+struct TuningProfile{
+    std::string cpuModel;
+    int availableThreads = 0;
+    std::string kernel = "CalculateSIMDPaths";
+    int blockSteps = 128;
+    int numThreads = 0;
+    int chunkPaths = 0;
+    long long singleThreadCutoff = 0;
+};
+
+std::mutex tuningProfileMutex;
+bool tuningProfileLoaded = false;
+bool tuningProfileValid = false;
+TuningProfile tuningProfile;
+
+std::string CpuModelName(){
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while(std::getline(in, line)){
+        if(line.compare(0, 10, "model name") == 0){
+            return TrimField(line.substr(line.find(':') + 1));
+        }
+    }
+    return "unknown";
+}
+
+//distinct (physical id, core id) pairs, i.e. cores without their hyperthread siblings
+int PhysicalCoreCount(){
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    std::set<std::pair<int, int>> cores;
+    int physicalId = 0;
+    while(std::getline(in, line)){
+        if(line.compare(0, 11, "physical id") == 0){
+            physicalId = std::atoi(line.substr(line.find(':') + 1).c_str());
+        }else if(line.compare(0, 7, "core id") == 0){
+            cores.insert({physicalId, std::atoi(line.substr(line.find(':') + 1).c_str())});
+        }
+    }
+    int available = AvailableThreadCount();
+    return cores.empty() ? available : std::min<int>(available, static_cast<int>(cores.size()));
+}
+
+//$GBM_TUNING_PROFILE, else ~/.gbm_tuning_profile
+std::string DefaultTuningProfilePath(){
+    if(const char* path = std::getenv("GBM_TUNING_PROFILE")){
+        return path;
+    }
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.gbm_tuning_profile";
+}
+
+bool WriteTuningProfile(const std::string& path, const TuningProfile& profile){
+    std::ofstream out(path, std::ios::trunc);
+    out << "cpuModel=" << profile.cpuModel << "\n"
+        << "availableThreads=" << profile.availableThreads << "\n"
+        << "kernel=" << profile.kernel << "\n"
+        << "blockSteps=" << profile.blockSteps << "\n"
+        << "numThreads=" << profile.numThreads << "\n"
+        << "chunkPaths=" << profile.chunkPaths << "\n"
+        << "singleThreadCutoff=" << profile.singleThreadCutoff << "\n";
+    return static_cast<bool>(out);
+}
+
+//key=value lines, false when the file is missing or was made on another machine
+bool ReadTuningProfile(const std::string& path, TuningProfile& profile){
+    std::ifstream in(path);
+    if(!in){
+        return false;
+    }
+    std::string line;
+    while(std::getline(in, line)){
+        size_t split = line.find('=');
+        if(split == std::string::npos){
+            continue;
+        }
+        std::string key = line.substr(0, split);
+        std::string value = line.substr(split + 1);
+        if(key == "cpuModel"){
+            profile.cpuModel = value;
+        }else if(key == "availableThreads"){
+            profile.availableThreads = std::atoi(value.c_str());
+        }else if(key == "kernel"){
+            profile.kernel = value;
+        }else if(key == "blockSteps"){
+            profile.blockSteps = std::max(1, std::atoi(value.c_str()));
+        }else if(key == "numThreads"){
+            profile.numThreads = std::atoi(value.c_str());
+        }else if(key == "chunkPaths"){
+            profile.chunkPaths = std::atoi(value.c_str());
+        }else if(key == "singleThreadCutoff"){
+            profile.singleThreadCutoff = std::atoll(value.c_str());
+        }
+    }
+    return profile.cpuModel == CpuModelName() && profile.availableThreads == AvailableThreadCount();
+}
+
+//copy of the active profile, loading the default file the first time, false when there is none
+bool ActiveTuningProfile(TuningProfile& profile){
+    std::lock_guard<std::mutex> lock(tuningProfileMutex);
+    if(!tuningProfileLoaded){
+        tuningProfileLoaded = true;
+        TuningProfile loaded;
+        if(ReadTuningProfile(DefaultTuningProfilePath(), loaded)){
+            tuningProfile = loaded;
+            tuningProfileValid = true;
+        }
+    }
+    profile = tuningProfile;
+    return tuningProfileValid;
+}
+
+void SetActiveTuningProfile(const TuningProfile& profile){
+    std::lock_guard<std::mutex> lock(tuningProfileMutex);
+    tuningProfileLoaded = true;
+    tuningProfileValid = true;
+    tuningProfile = profile;
+}
+
+SIMDKernel KernelByName(const std::string& name, int blockSteps){
+    if(name == "BlockRNG512" && HasAVX512()){
+        return [blockSteps](int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT){
+            return CalculateSIMDPathsBlockRNG512(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, blockSteps);
+        };
+    }
+    if(name == "BlockRNG" || name == "BlockRNG512"){
+        return [blockSteps](int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT){
+            return CalculateSIMDPathsBlockRNG(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, blockSteps);
+        };
+    }
+    if(name.compare(0, 11, "Interleaved") == 0){
+        return InterleavedKernel(std::atoi(name.c_str() + 11));
+    }
+    return CalculateSIMDPaths;
+}
+
+//average final price of totalPaths paths run through kernel. chunkPaths <= 0 gives each thread one
+//equal share, otherwise threads keep pulling chunks of chunkPaths paths until none are left
+//counters, when given, are opened by each worker around its kernel calls
+double RunSIMDKernelMT(const SIMDKernel& kernel, int totalPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT,
+                       int numThreads, int chunkPaths, PerfCounterTotals* counters = nullptr)
+{
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    if(totalPaths <= 0){
+        return 0.0;
+    }
+    if(numThreads == 1){
+        ScopedPerfCounters perfCounters(counters);
+        TraceScope trace("kernel");
+        return kernel(totalPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT);
+    }
+    std::vector<double> sums(numThreads, 0.0);
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    int numChunks = chunkPaths > 0 ? (totalPaths + chunkPaths - 1) / chunkPaths : 0;
+    std::atomic<int> nextChunk(0);
+
+    for (int i = 0; i < numThreads; ++i) {
+        int numPaths = pathsPerThread + (i < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, i, numPaths]() {
+            ScopedPerfCounters perfCounters(counters);
+            TraceScope trace("worker");
+            if(chunkPaths <= 0){
+                TraceScope kernelTrace("kernel");
+                sums[i] = numPaths > 0 ? numPaths * kernel(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT) : 0.0;
+                return;
+            }
+            for(int chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++){
+                TraceScope chunkTrace("chunk");
+                int chunkSize = std::min(chunkPaths, totalPaths - chunk * chunkPaths);
+                sums[i] += chunkSize * kernel(chunkSize, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT);
+            }
+        });
+    }
+
+    {
+        TraceScope trace("join");
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    TraceScope trace("reduce");
+    double totalSum = 0.0;
+    for (double sum : sums) {
+        totalSum += sum;
+    }
+    return totalSum / totalPaths;
+}
+
+std::pair<std::vector<std::vector<double>>, double> SimulateGBMMultiThreaded(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int totalPaths, int numThreads,
+                                                                             PerfCounterTotals* counters = nullptr) {
     double deltaT = 1.0 / steps;
     double partialComputation = (normalizedMu - 0.5 * normalizedVar) * deltaT;
     double sqrtDeltaT = std::sqrt(deltaT);
@@ -133,7 +1133,11 @@ std::pair<std::vector<std::vector<double>>, double> SimulateGBMMultiThreaded(dou
     std::atomic<double> totalAverage(0.0);
     std::vector<std::vector<double>> displayPaths;
 
-    int numThreads = std::thread::hardware_concurrency();
+    TuningProfile profile;
+    if(numThreads <= 0 && ActiveTuningProfile(profile)){
+        numThreads = profile.numThreads;
+    }
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
     std::vector<std::thread> threads;
     int pathsPerThread = totalPaths / numThreads;
     int remainingPaths = totalPaths % numThreads;
@@ -141,7 +1145,7 @@ std::pair<std::vector<std::vector<double>>, double> SimulateGBMMultiThreaded(dou
     for (int i = 0; i < numThreads; ++i) {
         int numPaths = pathsPerThread + (i < remainingPaths ? 1 : 0);
         threads.emplace_back(simulatePaths, numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT,
-                             std::ref(totalAverage), std::ref(displayPaths), (i == 0)); 
+                             std::ref(totalAverage), std::ref(displayPaths), (i == 0), counters); 
     }
 
     for (auto& thread : threads) {
@@ -153,7 +1157,10 @@ std::pair<std::vector<std::vector<double>>, double> SimulateGBMMultiThreaded(dou
     return {displayPaths, averagePredictedPrice};
 }
 
-std::pair<std::vector<std::vector<double>>,double> SimulateGBMIntrinsicMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int totalPaths){
+//display paths come from a scalar loop, the averages from the given SIMD kernel on every thread. Kernels with
+//non normal innovations pass displayShock so the display paths are drawn from the same distribution
+std::pair<std::vector<std::vector<double>>,double> SimulateGBMKernelMT(const SIMDKernel& kernel, double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int totalPaths, int numThreads, int chunkPaths = 0,
+                                                                       PerfCounterTotals* counters = nullptr, const std::function<double(std::mt19937&)>& displayShock = nullptr){
     double deltaT = 1.0 / steps;
     double partialComputation = (normalizedMu - 0.5 * normalizedVar) * deltaT;
     double sqrtDeltaT = std::sqrt(deltaT);
@@ -167,39 +1174,46 @@ std::pair<std::vector<std::vector<double>>,double> SimulateGBMIntrinsicMT(double
         std::vector<double> path(steps, startingPrice);
         double price = startingPrice;
         for (int j = 1; j < steps; ++j) {
-            double noise = d(gen);
+            double noise = displayShock ? displayShock(gen) : d(gen);
             price *= std::exp(partialComputation + normalizedStd * sqrtDeltaT * noise);
             path[j] = price;
         }
         displayPaths.push_back(std::move(path));
     }
 
-    int numThreads = std::thread::hardware_concurrency();
-    std::vector<std::thread> threads;
-    int pathsPerThread = totalPaths / numThreads;
-    int remainingPaths = totalPaths % numThreads;
+    double totalAveragePrice = RunSIMDKernelMT(kernel, totalPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, numThreads, chunkPaths, counters);
 
-    std::vector<double> averagePrices(numThreads);
+    return {displayPaths, totalAveragePrice};
 
-    for (int i = 0; i < numThreads; ++i) {
-        int numPaths = pathsPerThread + (i < remainingPaths ? 1 : 0);
-        threads.emplace_back([&averagePrices, i, numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT]() {
-            double averagePrice = CalculateSIMDPaths(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT);
-            averagePrices[i] = averagePrice;
-        });
-    }
+}
 
-    for (auto& thread : threads) {
-        thread.join();
+//uses the kernel, thread count, chunking and small run cutoff of the machine's tuning profile when one exists,
+//an explicit numThreads still wins
+std::pair<std::vector<std::vector<double>>,double> SimulateGBMIntrinsicMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int totalPaths, int numThreads,
+                                                                          PerfCounterTotals* counters = nullptr){
+    TuningProfile profile;
+    if(!ActiveTuningProfile(profile)){
+        return SimulateGBMKernelMT(CalculateSIMDPaths, startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths, numThreads, 0, counters);
     }
-    double totalAveragePrice = 0.0;
-    for (double price : averagePrices) {
-        totalAveragePrice += price;
+    if(numThreads <= 0){
+        bool smallRun = static_cast<long long>(totalPaths) * steps < profile.singleThreadCutoff;
+        numThreads = smallRun ? 1 : profile.numThreads;
     }
-    totalAveragePrice /= numThreads;
+    return SimulateGBMKernelMT(KernelByName(profile.kernel, profile.blockSteps), startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths,
+                               numThreads, profile.chunkPaths, counters);
+}
 
-    return {displayPaths, totalAveragePrice};
+std::pair<std::vector<std::vector<double>>,double> SimulateGBMBlockRNGMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int totalPaths, int blockSteps, int numThreads){
+    if(blockSteps <= 0){
+        return SimulateGBMKernelMT(CalculateSIMDPathsBlockRNGDefault, startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths, numThreads);
+    }
+    return SimulateGBMKernelMT([blockSteps](int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT){
+        return CalculateSIMDPathsBlockRNG(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, blockSteps);
+    }, startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths, numThreads);
+}
 
+std::pair<std::vector<std::vector<double>>,double> SimulateGBMInterleavedMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int totalPaths, int streams, int numThreads){
+    return SimulateGBMKernelMT(InterleavedKernel(streams), startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths, numThreads);
 }
 
 std::pair<std::vector<std::vector<double>>,double> SimulatedGBM(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd,int steps, int paths){
@@ -235,13 +1249,4564 @@ std::pair<std::vector<std::vector<double>>,double> SimulatedGBM(double startingP
     return {fullPaths, averagePredictedPrice};
 } 
 
-PYBIND11_MODULE(simulation, m) {
-    m.doc() = "Simulation module for performing GBM simulations and calculating statistics"; // Module docstring
-    m.def("add", &add, "A function which adds two numbers");
-    m.def("SimulatedGBM", &SimulatedGBM, "Simulate paths for Geometric Brownian Motion and calculate the average final price",
-        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"));
-    m.def("SimulateGBMMultiThreaded",&SimulateGBMMultiThreaded,"Simulate Paths for GBM using multiple threads",
-        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"));
-    m.def("SimulateGBMIntrinsicMT",&SimulateGBMIntrinsicMT,"Using SIMD instructions",
+//Binary columnar cache written next to a parsed CSV as "<file>.gbmcache"
+//layout: header | int64 dates[rows] (epoch seconds) | float64 closes[rows]
+//the header records the source size, mtime and FNV-1a hash so stale caches are detected
+struct PriceCacheHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int64_t rows;
+    int64_t sourceMtime;
+    int64_t sourceSize;
+    uint64_t sourceHash;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(PriceCacheHeader) == 64, "cache header must keep the columns 8 byte aligned");
+const char priceCacheMagic[8] = {'G','B','M','C','A','C','H','E'};
+//version 2: missing closes are kept as NaN rows instead of being dropped
+const uint32_t priceCacheVersion = 2;
+
+//parsed price history, either backed by a mapped cache file or by owned vectors
+//when the cache could not be written (e.g. read only data directory)
+struct PriceHistory{
+    const int64_t* dates = nullptr;
+    const double* closes = nullptr;
+    int64_t rows = 0;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<int64_t> ownedDates;
+    std::vector<double> ownedCloses;
+
+    PriceHistory() = default;
+    PriceHistory(const PriceHistory&) = delete;
+    PriceHistory& operator=(const PriceHistory&) = delete;
+    ~PriceHistory(){
+        if(mapping){
+            munmap(mapping, mappingSize);
+        }
+    }
+};
+
+uint64_t HashBytes(const char* data, size_t size){
+    uint64_t hash = 1469598103934665603ULL;
+    for(size_t i=0; i<size; ++i){
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//days since 1970-01-01 for a proleptic gregorian date
+int64_t DaysFromCivil(int64_t year, int64_t month, int64_t day){
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+//accepts the date layouts pd.to_datetime reads in these files: YYYY-MM-DD, YYYY/MM/DD or MM/DD/YYYY, an optional
+//[ T]HH:MM[:SS[.fff]] time and an optional Z / +HH:MM / -HHMM offset, converted to UTC. Anything else is rejected
+bool ParseEpochSeconds(const std::string& text, int64_t& epochSeconds){
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, consumed = 0;
+    double second = 0.0;
+    const char* cursor = text.c_str();
+    bool parsed = (std::sscanf(cursor, "%4d-%2d-%2d%n", &year, &month, &day, &consumed) == 3 && consumed == 10)
+               || (std::sscanf(cursor, "%4d/%2d/%2d%n", &year, &month, &day, &consumed) == 3 && consumed == 10)
+               || (std::sscanf(cursor, "%2d/%2d/%4d%n", &month, &day, &year, &consumed) == 3 && consumed >= 8);
+    if(!parsed || month < 1 || month > 12 || day < 1 || day > 31){
+        return false;
+    }
+    cursor += consumed;
+    if(*cursor == ' ' || *cursor == 'T'){
+        consumed = 0;
+        if(std::sscanf(cursor + 1, "%2d:%2d%n", &hour, &minute, &consumed) != 2 || consumed == 0){
+            return false;
+        }
+        cursor += 1 + consumed;
+        if(*cursor == ':'){
+            char* end = nullptr;
+            second = std::strtod(cursor + 1, &end);
+            if(end == cursor + 1){
+                return false;
+            }
+            cursor = end;
+        }
+    }
+    int64_t offset = 0;
+    if(*cursor == 'Z'){
+        ++cursor;
+    }else if(*cursor == '+' || *cursor == '-'){
+        int offsetHours = 0, offsetMinutes = 0;
+        consumed = 0;
+        if(std::sscanf(cursor + 1, "%2d:%2d%n", &offsetHours, &offsetMinutes, &consumed) != 2 &&
+           std::sscanf(cursor + 1, "%2d%2d%n", &offsetHours, &offsetMinutes, &consumed) != 2){
+            return false;
+        }
+        offset = (*cursor == '+' ? 1 : -1) * (offsetHours * 3600 + offsetMinutes * 60);
+        cursor += 1 + consumed;
+    }
+    if(*cursor != '\0'){
+        return false;
+    }
+    epochSeconds = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + static_cast<int64_t>(second) - offset;
+    return true;
+}
+
+//the missing value tokens pandas.read_csv turns into NaN by default
+bool IsMissingField(const std::string& field){
+    static const std::set<std::string> missing = {"", "null", "NULL", "NaN", "nan", "NA", "N/A", "n/a", "#N/A", "None", "-NaN", "-nan"};
+    return missing.count(field) > 0;
+}
+
+//pulls the Date and Close columns out of a CSV, rows are returned sorted by date like ReadCsvData did on the python
+//side. Missing closes ("null", empty, ...) stay as NaN rows the way read_csv keeps them; a date or close that cannot
+//be parsed throws with its line number rather than silently shortening the history
+void ParsePriceCsv(const std::string& text, std::vector<int64_t>& dates, std::vector<double>& closes){
+    std::istringstream stream(text);
+    std::string line;
+    if(!std::getline(stream, line)){
+        throw std::runtime_error("CSV file is empty");
+    }
+    int dateColumn = -1, closeColumn = -1, column = 0;
+    std::string field;
+    std::istringstream header(line);
+    while(std::getline(header, field, ',')){
+        std::string name = TrimField(field);
+        if(name == "Date"){
+            dateColumn = column;
+        }else if(name == "Close"){
+            closeColumn = column;
+        }
+        ++column;
+    }
+    if(dateColumn < 0 || closeColumn < 0){
+        throw std::runtime_error("CSV file needs Date and Close columns");
+    }
+
+    bool sorted = true;
+    size_t lineNumber = 1;
+    while(std::getline(stream, line)){
+        ++lineNumber;
+        if(TrimField(line).empty()){
+            continue;
+        }
+        std::istringstream row(line);
+        std::string dateField, closeField;
+        column = 0;
+        while(std::getline(row, field, ',')){
+            if(column == dateColumn){
+                dateField = TrimField(field);
+            }else if(column == closeColumn){
+                closeField = TrimField(field);
+            }
+            ++column;
+        }
+        int64_t epochSeconds;
+        if(!ParseEpochSeconds(dateField, epochSeconds)){
+            throw std::runtime_error("unparseable Date '" + dateField + "' on line " + std::to_string(lineNumber));
+        }
+        double close = std::numeric_limits<double>::quiet_NaN();
+        if(!IsMissingField(closeField)){
+            char* parseEnd = nullptr;
+            close = std::strtod(closeField.c_str(), &parseEnd);
+            if(*parseEnd != '\0'){
+                throw std::runtime_error("unparseable Close '" + closeField + "' on line " + std::to_string(lineNumber));
+            }
+        }
+        if(!dates.empty() && epochSeconds < dates.back()){
+            sorted = false;
+        }
+        dates.push_back(epochSeconds);
+        closes.push_back(close);
+    }
+    if(!sorted){
+        std::vector<size_t> order(dates.size());
+        for(size_t i=0; i<order.size(); ++i){
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&dates](size_t a, size_t b){ return dates[a] < dates[b]; });
+        std::vector<int64_t> sortedDates(dates.size());
+        std::vector<double> sortedCloses(closes.size());
+        for(size_t i=0; i<order.size(); ++i){
+            sortedDates[i] = dates[order[i]];
+            sortedCloses[i] = closes[order[i]];
+        }
+        dates = std::move(sortedDates);
+        closes = std::move(sortedCloses);
+    }
+}
+
+//writes to a temporary file and renames it so concurrent loaders never map a half written cache
+bool WritePriceCache(const std::string& cachePath, const PriceCacheHeader& header, const std::vector<int64_t>& dates, const std::vector<double>& closes){
+    std::string temporaryPath = cachePath + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if(!out){
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(dates.data()), dates.size() * sizeof(int64_t));
+        out.write(reinterpret_cast<const char*>(closes.data()), closes.size() * sizeof(double));
+        if(!out){
+            out.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    if(std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0){
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+//maps a cache file and checks it against the source CSV, returns nullptr when it is missing or stale
+std::shared_ptr<PriceHistory> MapPriceCache(const std::string& cachePath, const std::string& filePath, int64_t sourceMtime, int64_t sourceSize){
+    int fd = open(cachePath.c_str(), O_RDONLY);
+    if(fd < 0){
+        return nullptr;
+    }
+    struct stat cacheStat;
+    if(fstat(fd, &cacheStat) != 0 || cacheStat.st_size < static_cast<off_t>(sizeof(PriceCacheHeader))){
+        close(fd);
+        return nullptr;
+    }
+    size_t mappingSize = static_cast<size_t>(cacheStat.st_size);
+    //private writable mapping so numpy views can be written to without touching the file
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED){
+        return nullptr;
+    }
+    auto history = std::make_shared<PriceHistory>();
+    history->mapping = mapping;
+    history->mappingSize = mappingSize;
+
+    const PriceCacheHeader* header = static_cast<const PriceCacheHeader*>(mapping);
+    if(std::memcmp(header->magic, priceCacheMagic, sizeof(priceCacheMagic)) != 0 || header->version != priceCacheVersion
+        || header->headerSize != sizeof(PriceCacheHeader) || header->rows < 0 || header->sourceSize != sourceSize
+        || mappingSize != sizeof(PriceCacheHeader) + static_cast<size_t>(header->rows) * (sizeof(int64_t) + sizeof(double))){
+        return nullptr;
+    }
+    if(header->sourceMtime != sourceMtime){
+        //file was touched, only trust the cache if the contents are unchanged
+        std::ifstream in(filePath, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if(HashBytes(text.data(), text.size()) != header->sourceHash){
+            return nullptr;
+        }
+    }
+    const char* columns = static_cast<const char*>(mapping) + sizeof(PriceCacheHeader);
+    history->rows = header->rows;
+    history->dates = reinterpret_cast<const int64_t*>(columns);
+    history->closes = reinterpret_cast<const double*>(columns + header->rows * sizeof(int64_t));
+    return history;
+}
+
+std::shared_ptr<PriceHistory> LoadCachedPriceHistory(const std::string& filePath){
+    struct stat sourceStat;
+    if(stat(filePath.c_str(), &sourceStat) != 0){
+        throw std::runtime_error("Could not open " + filePath);
+    }
+    int64_t sourceMtime = static_cast<int64_t>(sourceStat.st_mtim.tv_sec) * 1000000000LL + sourceStat.st_mtim.tv_nsec;
+    int64_t sourceSize = static_cast<int64_t>(sourceStat.st_size);
+    std::string cachePath = filePath + ".gbmcache";
+
+    std::shared_ptr<PriceHistory> history = MapPriceCache(cachePath, filePath, sourceMtime, sourceSize);
+    if(history){
+        return history;
+    }
+
+    std::ifstream in(filePath, std::ios::binary);
+    if(!in){
+        throw std::runtime_error("Could not open " + filePath);
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<int64_t> dates;
+    std::vector<double> closes;
+    ParsePriceCsv(text, dates, closes);
+
+    PriceCacheHeader header{};
+    std::memcpy(header.magic, priceCacheMagic, sizeof(priceCacheMagic));
+    header.version = priceCacheVersion;
+    header.headerSize = sizeof(PriceCacheHeader);
+    header.rows = static_cast<int64_t>(dates.size());
+    header.sourceMtime = sourceMtime;
+    header.sourceSize = sourceSize;
+    header.sourceHash = HashBytes(text.data(), text.size());
+    if(WritePriceCache(cachePath, header, dates, closes)){
+        history = MapPriceCache(cachePath, filePath, sourceMtime, sourceSize);
+        if(history){
+            return history;
+        }
+    }
+    history = std::make_shared<PriceHistory>();
+    history->ownedDates = std::move(dates);
+    history->ownedCloses = std::move(closes);
+    history->rows = static_cast<int64_t>(history->ownedDates.size());
+    history->dates = history->ownedDates.data();
+    history->closes = history->ownedCloses.data();
+    return history;
+}
+
+//returns (dates, closes) as numpy arrays viewing the mapped cache, the capsule keeps the mapping alive
+py::tuple LoadPriceHistory(const std::string& filePath){
+    std::shared_ptr<PriceHistory> history = LoadCachedPriceHistory(filePath);
+    auto* owner = new std::shared_ptr<PriceHistory>(history);
+    py::capsule base(owner, [](void* p){ delete static_cast<std::shared_ptr<PriceHistory>*>(p); });
+    py::array_t<int64_t> dates({static_cast<py::ssize_t>(history->rows)}, {static_cast<py::ssize_t>(sizeof(int64_t))}, history->dates, base);
+    py::array_t<double> closes({static_cast<py::ssize_t>(history->rows)}, {static_cast<py::ssize_t>(sizeof(double))}, history->closes, base);
+    return py::make_tuple(dates, closes);
+}
+
+//hands a vector over to numpy without copying, the capsule frees it with the array
+template<typename T>
+py::array_t<T> VectorToArray(std::vector<T>&& values, std::vector<py::ssize_t> shape){
+    auto* owner = new std::vector<T>(std::move(values));
+    py::capsule base(owner, [](void* p){ delete static_cast<std::vector<T>*>(p); });
+    std::vector<py::ssize_t> strides(shape.size());
+    py::ssize_t stride = sizeof(T);
+    for(size_t i=shape.size(); i-- > 0;){
+        strides[i] = stride;
+        stride *= shape[i];
+    }
+    return py::array_t<T>(shape, strides, owner->data(), base);
+}
+
+//closes of many tickers aligned on the union of their dates, row major (dates x tickers), NaN where a ticker has no row
+//files that failed to load are reported in skipped as (ticker, error) instead of aborting the whole panel
+struct PricePanel{
+    std::vector<std::string> tickers;
+    std::vector<int64_t> dates;
+    std::vector<double> closes;
+    std::vector<std::pair<std::string, std::string>> skipped;
+};
+
+//per ticker CalculateStatistics over the training window, NaN for tickers without two returns
+struct PanelStatistics{
+    std::vector<double> trainingMu;
+    std::vector<double> trainingDeviation;
+    std::vector<double> trainingVariance;
+    std::vector<double> normalizedMu;
+    std::vector<double> normalizedVariance;
+    std::vector<double> normalizedDeviation;
+    std::vector<double> startingPrice;
+};
+
+PricePanel LoadPricePanelData(const std::string& directory, int numThreads){
+    std::vector<std::filesystem::path> files;
+    for(const auto& entry : std::filesystem::directory_iterator(directory)){
+        if(entry.is_regular_file() && entry.path().extension() == ".csv"){
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    //files are handed out one at a time so a few large histories do not stall a thread
+    std::vector<std::shared_ptr<PriceHistory>> histories(files.size());
+    std::vector<std::string> errors(files.size());
+    std::atomic<size_t> nextFile(0);
+    numThreads = ResolveThreadCount(numThreads, static_cast<long long>(files.size()));
+    std::vector<std::thread> threads;
+    for(int i=0; i<numThreads; ++i){
+        threads.emplace_back([&files, &histories, &errors, &nextFile](){
+            for(size_t f = nextFile++; f < files.size(); f = nextFile++){
+                try{
+                    histories[f] = LoadCachedPriceHistory(files[f].string());
+                }catch(const std::exception& error){
+                    //a file that does not load (missing columns, a bad row) is left out of the panel but reported
+                    errors[f] = error.what();
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+
+    PricePanel panel;
+    std::vector<std::shared_ptr<PriceHistory>> loaded;
+    for(size_t f=0; f<files.size(); ++f){
+        if(histories[f] && histories[f]->rows > 0){
+            panel.tickers.push_back(files[f].stem().string());
+            loaded.push_back(histories[f]);
+        }else if(!histories[f]){
+            panel.skipped.emplace_back(files[f].stem().string(), errors[f]);
+        }
+    }
+    for(const auto& history : loaded){
+        panel.dates.insert(panel.dates.end(), history->dates, history->dates + history->rows);
+    }
+    std::sort(panel.dates.begin(), panel.dates.end());
+    panel.dates.erase(std::unique(panel.dates.begin(), panel.dates.end()), panel.dates.end());
+
+    size_t numTickers = loaded.size();
+    panel.closes.assign(panel.dates.size() * numTickers, std::numeric_limits<double>::quiet_NaN());
+    std::atomic<size_t> nextTicker(0);
+    threads.clear();
+    for(int i=0; i<numThreads; ++i){
+        threads.emplace_back([&panel, &loaded, &nextTicker, numTickers](){
+            for(size_t t = nextTicker++; t < numTickers; t = nextTicker++){
+                const PriceHistory& history = *loaded[t];
+                size_t row = 0;
+                for(int64_t k=0; k<history.rows; ++k){
+                    while(panel.dates[row] < history.dates[k]){
+                        ++row;
+                    }
+                    panel.closes[row * numTickers + t] = history.closes[k];
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    return panel;
+}
+
+//one pass over the window with tickers as the inner loop, so each row of closes is read contiguously. The log stays
+//the scalar std::log: returns are differences of nearby logs and an approximate SIMD log would swamp them
+//returns between consecutive rows a ticker actually has, the first row of the window only seeds the previous close
+//matches CalculateStatistics: window is [startDate, endDate), std uses n-1, same normalisation by steps
+void AccumulatePanelStatistics(const double* closes, size_t numTickers, size_t firstRow, size_t lastRow, size_t columnBegin, size_t columnEnd,
+                               int steps, PanelStatistics& stats)
+{
+    size_t width = columnEnd - columnBegin;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> previousLog(width, nan), shift(width, nan), sum(width, 0.0), sumSquares(width, 0.0), count(width, 0.0);
+    for(size_t row=firstRow; row<lastRow; ++row){
+        const double* rowCloses = closes + row * numTickers + columnBegin;
+        for(size_t c=0; c<width; ++c){
+            double logClose = std::log(rowCloses[c]);
+            double logReturn = logClose - previousLog[c];
+            bool valid = logReturn == logReturn;
+            //shifting by the first return keeps the single pass variance stable
+            shift[c] = (valid && count[c] == 0.0) ? logReturn : shift[c];
+            double shifted = valid ? logReturn - shift[c] : 0.0;
+            sum[c] += shifted;
+            sumSquares[c] += shifted * shifted;
+            count[c] += valid ? 1.0 : 0.0;
+            previousLog[c] = logClose == logClose ? logClose : previousLog[c];
+        }
+    }
+    for(size_t c=0; c<width; ++c){
+        size_t t = columnBegin + c;
+        double n = count[c];
+        double mu = n > 0 ? shift[c] + sum[c] / n : nan;
+        double variance = n > 1 ? (sumSquares[c] - sum[c] * sum[c] / n) / (n - 1) : nan;
+        double deviation = std::sqrt(variance);
+        stats.trainingMu[t] = mu;
+        stats.trainingDeviation[t] = deviation;
+        stats.trainingVariance[t] = deviation * deviation;
+        stats.normalizedMu[t] = mu * steps;
+        stats.normalizedVariance[t] = deviation * deviation * std::sqrt(static_cast<double>(steps));
+        stats.normalizedDeviation[t] = std::sqrt(deviation);
+        stats.startingPrice[t] = std::exp(previousLog[c]);
+    }
+}
+
+PanelStatistics CalculatePanelStatisticsData(const int64_t* dates, size_t numDates, const double* closes, size_t numTickers,
+                                             int64_t startDate, int64_t endDate, int steps, int numThreads)
+{
+    size_t firstRow = std::lower_bound(dates, dates + numDates, startDate) - dates;
+    size_t lastRow = std::lower_bound(dates, dates + numDates, endDate) - dates;
+    PanelStatistics stats;
+    for(auto* column : {&stats.trainingMu, &stats.trainingDeviation, &stats.trainingVariance, &stats.normalizedMu,
+                        &stats.normalizedVariance, &stats.normalizedDeviation, &stats.startingPrice}){
+        column->assign(numTickers, std::numeric_limits<double>::quiet_NaN());
+    }
+    //contiguous ticker blocks per thread, wide enough that rows stay cache line aligned between threads
+    const size_t minBlock = 64;
+    numThreads = ResolveThreadCount(numThreads, static_cast<long long>((numTickers + minBlock - 1) / minBlock));
+    size_t block = (numTickers + numThreads - 1) / numThreads;
+    std::vector<std::thread> threads;
+    for(int i=0; i<numThreads; ++i){
+        size_t columnBegin = std::min(numTickers, i * block);
+        size_t columnEnd = std::min(numTickers, columnBegin + block);
+        threads.emplace_back(AccumulatePanelStatistics, closes, numTickers, firstRow, lastRow, columnBegin, columnEnd, steps, std::ref(stats));
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    return stats;
+}
+
+//one GBM simulation per ticker, path counts are split into chunks when there are fewer tickers than threads
+std::vector<double> SimulateGBMBatchData(const double* startingPrices, const double* normalizedMu, const double* normalizedVar, const double* normalizedStd,
+                                         size_t numTickers, int steps, int paths, int numThreads)
+{
+    double deltaT = 1.0 / steps;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    numThreads = ResolveThreadCount(numThreads);
+    int chunksPerTicker = std::max<int>(1, std::min<int>((numThreads + numTickers - 1) / std::max<size_t>(numTickers, 1), paths / 4));
+    //chunks are multiples of 4 except the ticker's last one, whose partial vector CalculateSIMDPaths leaves out of its sum
+    int pathsPerChunk = ((paths / chunksPerTicker) + 3) / 4 * 4;
+    size_t numTasks = numTickers * chunksPerTicker;
+    std::vector<double> chunkSums(numTasks, 0.0);
+    std::atomic<size_t> nextTask(0);
+    std::vector<std::thread> threads;
+    for(int i=0; i<numThreads; ++i){
+        threads.emplace_back([&, chunksPerTicker, pathsPerChunk](){
+            for(size_t task = nextTask++; task < numTasks; task = nextTask++){
+                size_t ticker = task / chunksPerTicker;
+                int chunk = static_cast<int>(task % chunksPerTicker);
+                int numPaths = std::min(pathsPerChunk, paths - chunk * pathsPerChunk);
+                if(numPaths <= 0 || !(startingPrices[ticker] > 0.0) || std::isnan(normalizedStd[ticker])){
+                    chunkSums[task] = std::numeric_limits<double>::quiet_NaN();
+                    continue;
+                }
+                double partialComputation = (normalizedMu[ticker] - 0.5 * normalizedVar[ticker]) * deltaT;
+                chunkSums[task] = numPaths * CalculateSIMDPaths(numPaths, steps, startingPrices[ticker], partialComputation, normalizedStd[ticker], sqrtDeltaT);
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    std::vector<double> averagePrices(numTickers, 0.0);
+    for(size_t task=0; task<numTasks; ++task){
+        int chunk = static_cast<int>(task % chunksPerTicker);
+        if(paths - chunk * pathsPerChunk > 0){
+            averagePrices[task / chunksPerTicker] += chunkSums[task];
+        }
+    }
+    for(double& price : averagePrices){
+        price /= paths;
+    }
+    return averagePrices;
+}
+
+py::dict LoadPricePanel(const std::string& directory, int numThreads){
+    PricePanel panel = LoadPricePanelData(directory, numThreads);
+    py::ssize_t numDates = static_cast<py::ssize_t>(panel.dates.size());
+    py::ssize_t numTickers = static_cast<py::ssize_t>(panel.tickers.size());
+    py::dict result;
+    result["tickers"] = panel.tickers;
+    result["dates"] = VectorToArray(std::move(panel.dates), {numDates});
+    result["closes"] = VectorToArray(std::move(panel.closes), {numDates, numTickers});
+    result["skipped"] = panel.skipped;
+    return result;
+}
+
+py::dict CalculatePanelStatistics(py::array_t<int64_t, py::array::c_style | py::array::forcecast> dates,
+                                  py::array_t<double, py::array::c_style | py::array::forcecast> closes,
+                                  int64_t startDate, int64_t endDate, int steps, int numThreads)
+{
+    if(closes.ndim() != 2 || dates.ndim() != 1 || closes.shape(0) != dates.shape(0)){
+        throw std::invalid_argument("closes must be a (dates x tickers) array matching dates");
+    }
+    size_t numTickers = static_cast<size_t>(closes.shape(1));
+    PanelStatistics stats = CalculatePanelStatisticsData(dates.data(), static_cast<size_t>(dates.shape(0)), closes.data(), numTickers,
+                                                         startDate, endDate, steps, numThreads);
+    py::ssize_t n = static_cast<py::ssize_t>(numTickers);
+    py::dict result;
+    result["trainingMu"] = VectorToArray(std::move(stats.trainingMu), {n});
+    result["trainingDeviation"] = VectorToArray(std::move(stats.trainingDeviation), {n});
+    result["trainingVariance"] = VectorToArray(std::move(stats.trainingVariance), {n});
+    result["normalizedMu"] = VectorToArray(std::move(stats.normalizedMu), {n});
+    result["normalizedVariance"] = VectorToArray(std::move(stats.normalizedVariance), {n});
+    result["normalizedDeviation"] = VectorToArray(std::move(stats.normalizedDeviation), {n});
+    result["startingPrice"] = VectorToArray(std::move(stats.startingPrice), {n});
+    return result;
+}
+
+py::array_t<double> SimulateGBMBatch(py::array_t<double, py::array::c_style | py::array::forcecast> startingPrices,
+                                     py::array_t<double, py::array::c_style | py::array::forcecast> normalizedMu,
+                                     py::array_t<double, py::array::c_style | py::array::forcecast> normalizedVar,
+                                     py::array_t<double, py::array::c_style | py::array::forcecast> normalizedStd,
+                                     int steps, int paths, int numThreads)
+{
+    py::ssize_t n = startingPrices.size();
+    if(normalizedMu.size() != n || normalizedVar.size() != n || normalizedStd.size() != n){
+        throw std::invalid_argument("parameter arrays must all have one entry per ticker");
+    }
+    std::vector<double> averagePrices;
+    {
+        TracedGILRelease release;
+        averagePrices = SimulateGBMBatchData(startingPrices.data(), normalizedMu.data(), normalizedVar.data(), normalizedStd.data(),
+                                             static_cast<size_t>(n), steps, paths, numThreads);
+    }
+    return VectorToArray(std::move(averagePrices), {n});
+}
+
+//pairwise complete covariance/correlation over a (dates x tickers) log return panel
+//a return is used when it is finite and its mask byte (if given) is non zero, each pair of tickers
+//only uses the dates where both are present. Work is split into tickerTile x tickerTile output tiles
+//and the dates are streamed in chunks that are packed into small buffers so both sides stay in L1/L2
+const size_t correlationTile = 32;
+const size_t correlationChunkRows = 256;
+
+struct CorrelationTileSums{
+    double count[correlationTile][correlationTile];
+    double sumI[correlationTile][correlationTile];
+    double sumJ[correlationTile][correlationTile];
+    double sumIJ[correlationTile][correlationTile];
+    double sumII[correlationTile][correlationTile];
+    double sumJJ[correlationTile][correlationTile];
+};
+
+//copies a chunk of rows for tickers [begin, end) into zero filled values and 0/1 presence
+void PackCorrelationChunk(const double* returns, const uint8_t* mask, size_t numTickers, size_t rowBegin, size_t rowEnd,
+                          size_t begin, size_t end, double* values, double* present)
+{
+    for(size_t row=rowBegin; row<rowEnd; ++row){
+        double* rowValues = values + (row - rowBegin) * correlationTile;
+        double* rowPresent = present + (row - rowBegin) * correlationTile;
+        for(size_t k=0; k<correlationTile; ++k){
+            size_t column = begin + k;
+            bool valid = false;
+            double value = 0.0;
+            if(column < end){
+                value = returns[row * numTickers + column];
+                valid = std::isfinite(value) && (mask == nullptr || mask[row * numTickers + column] != 0);
+            }
+            rowValues[k] = valid ? value : 0.0;
+            rowPresent[k] = valid ? 1.0 : 0.0;
+        }
+    }
+}
+
+void CorrelationTilePair(const double* returns, const uint8_t* mask, size_t numDates, size_t numTickers,
+                         size_t iBegin, size_t jBegin, double* covariance, double* correlation)
+{
+    size_t iEnd = std::min(numTickers, iBegin + correlationTile);
+    size_t jEnd = std::min(numTickers, jBegin + correlationTile);
+    auto sums = std::make_unique<CorrelationTileSums>();
+    std::memset(sums.get(), 0, sizeof(CorrelationTileSums));
+    alignas(32) static thread_local double valuesI[correlationChunkRows * correlationTile];
+    alignas(32) static thread_local double presentI[correlationChunkRows * correlationTile];
+    alignas(32) static thread_local double valuesJ[correlationChunkRows * correlationTile];
+    alignas(32) static thread_local double presentJ[correlationChunkRows * correlationTile];
+
+    for(size_t rowBegin=0; rowBegin<numDates; rowBegin+=correlationChunkRows){
+        size_t rowEnd = std::min(numDates, rowBegin + correlationChunkRows);
+        PackCorrelationChunk(returns, mask, numTickers, rowBegin, rowEnd, iBegin, iEnd, valuesI, presentI);
+        PackCorrelationChunk(returns, mask, numTickers, rowBegin, rowEnd, jBegin, jEnd, valuesJ, presentJ);
+        for(size_t r=0; r<rowEnd-rowBegin; ++r){
+            const double* xj = valuesJ + r * correlationTile;
+            const double* mj = presentJ + r * correlationTile;
+            for(size_t i=0; i<correlationTile; ++i){
+                double xi = valuesI[r * correlationTile + i];
+                double mi = presentI[r * correlationTile + i];
+                double xxi = xi * xi;
+                //inner loop over j is contiguous and branch free so it compiles to packed FMAs
+                for(size_t j=0; j<correlationTile; ++j){
+                    sums->count[i][j] += mi * mj[j];
+                    sums->sumI[i][j] += xi * mj[j];
+                    sums->sumJ[i][j] += mi * xj[j];
+                    sums->sumIJ[i][j] += xi * xj[j];
+                    sums->sumII[i][j] += xxi * mj[j];
+                    sums->sumJJ[i][j] += mi * xj[j] * xj[j];
+                }
+            }
+        }
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for(size_t i=iBegin; i<iEnd; ++i){
+        for(size_t j=jBegin; j<jEnd; ++j){
+            size_t a = i - iBegin, b = j - jBegin;
+            double n = sums->count[a][b];
+            double cov = nan, corr = nan;
+            if(n > 1){
+                double crossDeviation = sums->sumIJ[a][b] - sums->sumI[a][b] * sums->sumJ[a][b] / n;
+                double deviationI = sums->sumII[a][b] - sums->sumI[a][b] * sums->sumI[a][b] / n;
+                double deviationJ = sums->sumJJ[a][b] - sums->sumJ[a][b] * sums->sumJ[a][b] / n;
+                cov = crossDeviation / (n - 1);
+                corr = i == j ? 1.0 : crossDeviation / std::sqrt(deviationI * deviationJ);
+            }
+            covariance[i * numTickers + j] = cov;
+            covariance[j * numTickers + i] = cov;
+            correlation[i * numTickers + j] = corr;
+            correlation[j * numTickers + i] = corr;
+        }
+    }
+}
+
+//shrinkage pulls the correlation towards the identity: (1 - shrinkage) * R + shrinkage * I,
+//the covariance is rebuilt from the shrunk correlation and the per ticker variances
+void CalculateCorrelationMatrixData(const double* returns, const uint8_t* mask, size_t numDates, size_t numTickers, double shrinkage,
+                                    double* covariance, double* correlation, int numThreads)
+{
+    size_t numTiles = (numTickers + correlationTile - 1) / correlationTile;
+    //only the upper triangle of tiles is computed, each tile writes its mirror image too
+    std::vector<std::pair<size_t, size_t>> tilePairs;
+    for(size_t i=0; i<numTiles; ++i){
+        for(size_t j=i; j<numTiles; ++j){
+            tilePairs.emplace_back(i * correlationTile, j * correlationTile);
+        }
+    }
+    std::atomic<size_t> nextPair(0);
+    numThreads = ResolveThreadCount(numThreads, static_cast<long long>(tilePairs.size()));
+    std::vector<std::thread> threads;
+    for(int t=0; t<numThreads; ++t){
+        threads.emplace_back([&](){
+            for(size_t p = nextPair++; p < tilePairs.size(); p = nextPair++){
+                CorrelationTilePair(returns, mask, numDates, numTickers, tilePairs[p].first, tilePairs[p].second, covariance, correlation);
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+
+    if(shrinkage > 0.0){
+        std::vector<double> deviations(numTickers);
+        for(size_t i=0; i<numTickers; ++i){
+            deviations[i] = std::sqrt(covariance[i * numTickers + i]);
+        }
+        for(size_t i=0; i<numTickers; ++i){
+            for(size_t j=0; j<numTickers; ++j){
+                double corr = (1.0 - shrinkage) * correlation[i * numTickers + j] + (i == j ? shrinkage : 0.0);
+                correlation[i * numTickers + j] = corr;
+                covariance[i * numTickers + j] = corr * deviations[i] * deviations[j];
+            }
+        }
+    }
+}
+
+py::tuple CalculateCorrelationMatrix(py::array_t<double, py::array::c_style | py::array::forcecast> logReturns, py::object mask, double shrinkage, int numThreads){
+    if(logReturns.ndim() != 2){
+        throw std::invalid_argument("logReturns must be a (dates x tickers) array");
+    }
+    if(shrinkage < 0.0 || shrinkage > 1.0){
+        throw std::invalid_argument("shrinkage must be between 0 and 1");
+    }
+    size_t numDates = static_cast<size_t>(logReturns.shape(0));
+    size_t numTickers = static_cast<size_t>(logReturns.shape(1));
+    py::array_t<uint8_t, py::array::c_style | py::array::forcecast> maskArray;
+    const uint8_t* maskData = nullptr;
+    if(!mask.is_none()){
+        maskArray = mask.cast<py::array_t<uint8_t, py::array::c_style | py::array::forcecast>>();
+        if(maskArray.ndim() != 2 || maskArray.shape(0) != logReturns.shape(0) || maskArray.shape(1) != logReturns.shape(1)){
+            throw std::invalid_argument("mask must have the same shape as logReturns");
+        }
+        maskData = maskArray.data();
+    }
+    py::ssize_t n = static_cast<py::ssize_t>(numTickers);
+    py::array_t<double> covariance({n, n});
+    py::array_t<double> correlation({n, n});
+    const double* returns = logReturns.data();
+    double* covarianceData = covariance.mutable_data();
+    double* correlationData = correlation.mutable_data();
+    {
+        TracedGILRelease release;
+        CalculateCorrelationMatrixData(returns, maskData, numDates, numTickers, shrinkage, covarianceData, correlationData, numThreads);
+    }
+    return py::make_tuple(covariance, correlation);
+}
+
+//circular moving block bootstrap of the training log returns, every resample is turned into the
+//same statistics CalculateStatistics produces. Each resample has its own generator seeded from
+//(seed, resample) so results do not depend on how the work was split across threads
+PanelStatistics BootstrapStatisticsData(const double* logReturns, size_t numReturns, int steps, int resamples, int blockLength, uint64_t seed, int numThreads){
+    if(numReturns < 2){
+        throw std::invalid_argument("need at least two log returns to bootstrap");
+    }
+    if(blockLength <= 0){
+        blockLength = std::max(1, static_cast<int>(std::lround(std::cbrt(static_cast<double>(numReturns)))));
+    }
+    PanelStatistics stats;
+    for(auto* column : {&stats.trainingMu, &stats.trainingDeviation, &stats.trainingVariance, &stats.normalizedMu,
+                        &stats.normalizedVariance, &stats.normalizedDeviation}){
+        column->resize(resamples);
+    }
+    numThreads = ResolveThreadCount(numThreads, resamples);
+    std::atomic<int> nextResample(0);
+    std::vector<std::thread> threads;
+    for(int t=0; t<numThreads; ++t){
+        threads.emplace_back([&, blockLength](){
+            for(int r = nextResample++; r < resamples; r = nextResample++){
+                std::mt19937_64 gen(MixSeed(seed ^ MixSeed(static_cast<uint64_t>(r))));
+                std::uniform_int_distribution<size_t> start(0, numReturns - 1);
+                //shifted by the first return of the sample for a stable single pass variance
+                double shift = 0.0, sum = 0.0, sumSquares = 0.0;
+                size_t drawn = 0;
+                while(drawn < numReturns){
+                    size_t index = start(gen);
+                    for(int k=0; k<blockLength && drawn<numReturns; ++k, ++drawn){
+                        double value = logReturns[index];
+                        if(drawn == 0){
+                            shift = value;
+                        }
+                        value -= shift;
+                        sum += value;
+                        sumSquares += value * value;
+                        index = index + 1 == numReturns ? 0 : index + 1;
+                    }
+                }
+                double n = static_cast<double>(numReturns);
+                double mu = shift + sum / n;
+                double deviation = std::sqrt((sumSquares - sum * sum / n) / (n - 1));
+                stats.trainingMu[r] = mu;
+                stats.trainingDeviation[r] = deviation;
+                stats.trainingVariance[r] = deviation * deviation;
+                stats.normalizedMu[r] = mu * steps;
+                stats.normalizedVariance[r] = deviation * deviation * std::sqrt(static_cast<double>(steps));
+                stats.normalizedDeviation[r] = std::sqrt(deviation);
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    return stats;
+}
+
+//seed 0 asks for a random one
+uint64_t ResolveSeed(uint64_t seed){
+    if(seed == 0){
+        std::random_device rd;
+        seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+    return seed;
+}
+
+py::dict BootstrapStatistics(py::array_t<double, py::array::c_style | py::array::forcecast> logReturns, int steps, int resamples, int blockLength, uint64_t seed, int numThreads){
+    seed = ResolveSeed(seed);
+    //NaN returns (e.g. the first row of a shifted series) are dropped before resampling
+    std::vector<double> returns;
+    returns.reserve(logReturns.size());
+    for(py::ssize_t i=0; i<logReturns.size(); ++i){
+        if(std::isfinite(logReturns.data()[i])){
+            returns.push_back(logReturns.data()[i]);
+        }
+    }
+    PanelStatistics stats;
+    {
+        TracedGILRelease release;
+        stats = BootstrapStatisticsData(returns.data(), returns.size(), steps, resamples, blockLength, seed, numThreads);
+    }
+    py::ssize_t n = resamples;
+    py::dict result;
+    result["trainingMu"] = VectorToArray(std::move(stats.trainingMu), {n});
+    result["trainingDeviation"] = VectorToArray(std::move(stats.trainingDeviation), {n});
+    result["trainingVariance"] = VectorToArray(std::move(stats.trainingVariance), {n});
+    result["normalizedMu"] = VectorToArray(std::move(stats.normalizedMu), {n});
+    result["normalizedVariance"] = VectorToArray(std::move(stats.normalizedVariance), {n});
+    result["normalizedDeviation"] = VectorToArray(std::move(stats.normalizedDeviation), {n});
+    return result;
+}
+
+//streaming sketch of a simulated terminal distribution: a fixed range histogram of log prices
+//(plus under/overflow point masses) and exact running sums, so no samples are stored and
+//per thread sketches merge by adding counts
+struct TerminalSketch{
+    double lowerLog = 0.0;
+    double binWidth = 1.0;
+    std::vector<double> counts;
+    double belowCount = 0.0, belowSum = 0.0;
+    double aboveCount = 0.0, aboveSum = 0.0;
+    double count = 0.0;
+    double sumPrices = 0.0;
+    double sumAbsoluteError = 0.0;
+    double realPrice = 0.0;
+
+    TerminalSketch(double lowerLog, double upperLog, int bins, double realPrice)
+        : lowerLog(lowerLog), binWidth((upperLog - lowerLog) / bins), counts(bins, 0.0), realPrice(realPrice) {}
+
+    void Add(double price, double logPrice){
+        //a NaN path would fail both range checks below and index the histogram with garbage, it is left out entirely
+        if(std::isnan(logPrice) || std::isnan(price)){
+            return;
+        }
+        count += 1.0;
+        sumPrices += price;
+        sumAbsoluteError += std::abs(price - realPrice);
+        double position = (logPrice - lowerLog) / binWidth;
+        if(position < 0.0){
+            belowCount += 1.0;
+            belowSum += price;
+        }else if(position >= counts.size()){
+            aboveCount += 1.0;
+            aboveSum += price;
+        }else{
+            counts[static_cast<size_t>(position)] += 1.0;
+        }
+    }
+
+    void Merge(const TerminalSketch& other){
+        for(size_t k=0; k<counts.size(); ++k){
+            counts[k] += other.counts[k];
+        }
+        belowCount += other.belowCount;
+        belowSum += other.belowSum;
+        aboveCount += other.aboveCount;
+        aboveSum += other.aboveSum;
+        count += other.count;
+        sumPrices += other.sumPrices;
+        sumAbsoluteError += other.sumAbsoluteError;
+    }
+
+    //the distribution as sorted (price, probability) atoms: underflow mean, bin centres, overflow mean
+    void Atoms(std::vector<double>& prices, std::vector<double>& weights) const {
+        prices.clear();
+        weights.clear();
+        if(belowCount > 0){
+            prices.push_back(belowSum / belowCount);
+            weights.push_back(belowCount / count);
+        }
+        for(size_t k=0; k<counts.size(); ++k){
+            if(counts[k] > 0){
+                prices.push_back(std::exp(lowerLog + (k + 0.5) * binWidth));
+                weights.push_back(counts[k] / count);
+            }
+        }
+        if(aboveCount > 0){
+            prices.push_back(aboveSum / aboveCount);
+            weights.push_back(aboveCount / count);
+        }
+    }
+
+    //inverse cdf, linear in log price inside a bin
+    double Quantile(double q) const {
+        double target = q * count;
+        double cumulative = belowCount;
+        if(target <= cumulative){
+            return belowCount > 0 ? belowSum / belowCount : std::exp(lowerLog);
+        }
+        for(size_t k=0; k<counts.size(); ++k){
+            if(cumulative + counts[k] >= target && counts[k] > 0){
+                double fraction = (target - cumulative) / counts[k];
+                return std::exp(lowerLog + (k + fraction) * binWidth);
+            }
+            cumulative += counts[k];
+        }
+        return aboveCount > 0 ? aboveSum / aboveCount : std::exp(lowerLog + counts.size() * binWidth);
+    }
+
+    double Cdf(double price) const {
+        double position = (std::log(price) - lowerLog) / binWidth;
+        if(position < 0.0){
+            return 0.0;
+        }
+        double cumulative = belowCount;
+        size_t bins = counts.size();
+        size_t whole = std::min(bins, static_cast<size_t>(position));
+        for(size_t k=0; k<whole; ++k){
+            cumulative += counts[k];
+        }
+        if(whole < bins){
+            cumulative += counts[whole] * (position - whole);
+        }else{
+            cumulative += aboveCount;
+        }
+        return cumulative / count;
+    }
+};
+
+struct ForecastScore{
+    double averagePrice;
+    double crps;
+    double absoluteError;
+    double pit;
+    std::vector<double> quantiles;
+    std::vector<double> quantilePrices;
+    std::vector<double> pinballLosses;
+    std::vector<double> intervalLevels;
+    std::vector<double> intervalCoverage;
+    std::vector<double> intervalWidths;
+};
+
+void SketchSIMDPaths(int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT,
+                     TerminalSketch& sketch)
+{
+    __m256d _normalStdVec = _mm256_set1_pd(normalizedStd);
+    __m256d _partialCompVec = _mm256_set1_pd(partialComputation);
+    __m256d _sqrtDTVec = _mm256_set1_pd(sqrtDeltaT);
+    __m256d _a = _mm256_mul_pd(_normalStdVec,_sqrtDTVec);
+    double logStart = std::log(startingPrice);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<double> d(0.0,1.0);
+
+    for(int i=0; i<numPaths; i+=4){
+        __m256d _prices = _mm256_set1_pd(startingPrice);
+        //log returns are summed next to the price so the sketch can bin without a log per path
+        __m256d _logReturns = _mm256_setzero_pd();
+        for(int j=1; j<steps; ++j){
+            alignas(32) double ranNums[4];
+            for(int k=0; k<4; ++k){
+                ranNums[k] = d(gen);
+            }
+            __m256d _c = _mm256_fmadd_pd(_a,_mm256_load_pd(ranNums),_partialCompVec);
+            _logReturns = _mm256_add_pd(_logReturns,_c);
+            _prices = _mm256_mul_pd(_prices,exp_approx(_c));
+        }
+        alignas(32) double finalPrices[4];
+        alignas(32) double finalLogs[4];
+        _mm256_store_pd(finalPrices,_prices);
+        _mm256_store_pd(finalLogs,_logReturns);
+        for(int k=0; k<4 && i+k<numPaths; ++k){
+            sketch.Add(finalPrices[k], logStart + finalLogs[k]);
+        }
+    }
+}
+
+//proper scores of the simulated terminal distribution against the realised price:
+//CRPS = E|X - y| - E|X - X'| / 2 with the first term exact and the second from the sketch,
+//pinball loss per quantile, and whether y fell inside each central interval
+ForecastScore ScoreForecastData(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int totalPaths,
+                                double realPrice, const std::vector<double>& quantiles, const std::vector<double>& intervalLevels, int bins, int numThreads)
+{
+    double deltaT = 1.0 / steps;
+    double partialComputation = (normalizedMu - 0.5 * normalizedVar) * deltaT;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    //histogram covers +-12 standard deviations of the terminal log price
+    double centre = std::log(startingPrice) + partialComputation * (steps - 1);
+    double halfWidth = 12.0 * normalizedStd * sqrtDeltaT * std::sqrt(static_cast<double>(std::max(steps - 1, 1))) + 1e-9;
+
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<TerminalSketch> sketches(numThreads, TerminalSketch(centre - halfWidth, centre + halfWidth, bins, realPrice));
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    for(int i=0; i<numThreads; ++i){
+        int numPaths = pathsPerThread + (i < remainingPaths ? 1 : 0);
+        threads.emplace_back(SketchSIMDPaths, numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, std::ref(sketches[i]));
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    TerminalSketch& sketch = sketches[0];
+    {
+        TraceScope trace("reduce");
+        for(int i=1; i<numThreads; ++i){
+            sketch.Merge(sketches[i]);
+        }
+    }
+
+    std::vector<double> prices, weights;
+    sketch.Atoms(prices, weights);
+    //E|X - X'| = 2 * sum_k w_k x_k (2 F(<k) + w_k - 1) over the sorted atoms
+    double meanAbsoluteDifference = 0.0, cumulative = 0.0;
+    for(size_t k=0; k<prices.size(); ++k){
+        meanAbsoluteDifference += 2.0 * weights[k] * prices[k] * (2.0 * cumulative + weights[k] - 1.0);
+        cumulative += weights[k];
+    }
+
+    ForecastScore score;
+    score.averagePrice = sketch.sumPrices / sketch.count;
+    score.absoluteError = sketch.sumAbsoluteError / sketch.count;
+    score.crps = score.absoluteError - 0.5 * meanAbsoluteDifference;
+    score.pit = sketch.Cdf(realPrice);
+    score.quantiles = quantiles;
+    for(double q : quantiles){
+        double quantilePrice = sketch.Quantile(q);
+        score.quantilePrices.push_back(quantilePrice);
+        score.pinballLosses.push_back((realPrice - quantilePrice) * (q - (realPrice < quantilePrice ? 1.0 : 0.0)));
+    }
+    score.intervalLevels = intervalLevels;
+    for(double level : intervalLevels){
+        double lower = sketch.Quantile(0.5 - 0.5 * level);
+        double upper = sketch.Quantile(0.5 + 0.5 * level);
+        score.intervalCoverage.push_back(realPrice >= lower && realPrice <= upper ? 1.0 : 0.0);
+        score.intervalWidths.push_back(upper - lower);
+    }
+    return score;
+}
+
+py::dict ScoreForecast(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int paths, double realPrice,
+                       std::vector<double> quantiles, std::vector<double> intervals, int bins, int numThreads)
+{
+    if(paths < 1 || steps < 2 || bins < 1){
+        throw std::invalid_argument("need at least one path, two steps and one bin");
+    }
+    if(!(realPrice > 0.0)){
+        throw std::invalid_argument("realPrice must be positive");
+    }
+    ForecastScore score;
+    {
+        TracedGILRelease release;
+        score = ScoreForecastData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, paths, realPrice, quantiles, intervals, bins, numThreads);
+    }
+    py::dict result;
+    result["averagePrice"] = score.averagePrice;
+    result["crps"] = score.crps;
+    result["absoluteError"] = score.absoluteError;
+    result["pit"] = score.pit;
+    result["quantiles"] = score.quantiles;
+    result["quantilePrices"] = score.quantilePrices;
+    result["pinballLosses"] = score.pinballLosses;
+    result["intervals"] = score.intervalLevels;
+    result["intervalCoverage"] = score.intervalCoverage;
+    result["intervalWidths"] = score.intervalWidths;
+    return result;
+}
+
+//Philox4x32-10 counter based generator (Salmon et al. 2011) on four lanes: the normals of a path are a pure
+//function of (seed, path index, step), so any path can be regenerated later without storing it.
+//Each 64 bit lane holds one 32 bit word of the counter/key in its low half
+void Philox4x32_10(__m256i& c0, __m256i& c1, __m256i& c2, __m256i& c3, __m256i k0, __m256i k1){
+    const __m256i _m0 = _mm256_set1_epi64x(0xD2511F53);
+    const __m256i _m1 = _mm256_set1_epi64x(0xCD9E8D57);
+    const __m256i _w0 = _mm256_set1_epi64x(0x9E3779B9);
+    const __m256i _w1 = _mm256_set1_epi64x(0xBB67AE85);
+    const __m256i _low = _mm256_set1_epi64x(0xFFFFFFFF);
+    for(int round=0; round<10; ++round){
+        __m256i _p0 = _mm256_mul_epu32(_m0,c0);
+        __m256i _p1 = _mm256_mul_epu32(_m1,c2);
+        __m256i _n0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(_p1,32),c1),k0);
+        __m256i _n2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(_p0,32),c3),k1);
+        c1 = _mm256_and_si256(_p1,_low);
+        c3 = _mm256_and_si256(_p0,_low);
+        c0 = _n0;
+        c2 = _n2;
+        k0 = _mm256_and_si256(_mm256_add_epi64(k0,_w0),_low);
+        k1 = _mm256_and_si256(_mm256_add_epi64(k1,_w1),_low);
+    }
+}
+
+//the two normals of steps 2*pair+1 and 2*pair+2 for the four paths in _paths, counter = (pair, 0, path lo, path hi)
+void CounterNormals(__m256i _paths, uint64_t pair, uint64_t seed, __m256d& first, __m256d& second){
+    const __m256i _low = _mm256_set1_epi64x(0xFFFFFFFF);
+    __m256i c0 = _mm256_set1_epi64x(static_cast<int64_t>(pair & 0xFFFFFFFF));
+    __m256i c1 = _mm256_set1_epi64x(static_cast<int64_t>(pair >> 32));
+    __m256i c2 = _mm256_and_si256(_paths,_low);
+    __m256i c3 = _mm256_srli_epi64(_paths,32);
+    Philox4x32_10(c0, c1, c2, c3, _mm256_set1_epi64x(static_cast<int64_t>(seed & 0xFFFFFFFF)), _mm256_set1_epi64x(static_cast<int64_t>(seed >> 32)));
+    //two 64 bit uniforms from the four words, top 52 bits each as in SIMDNormalGenerator
+    const __m256i _one = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    __m256i _bits1 = _mm256_or_si256(_mm256_slli_epi64(c0,32),c1);
+    __m256i _bits2 = _mm256_or_si256(_mm256_slli_epi64(c2,32),c3);
+    __m256d _u1 = _mm256_sub_pd(_mm256_set1_pd(2.0),_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(_bits1,12),_one)));
+    __m256d _u2 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(_bits2,12),_one)),_mm256_set1_pd(1.0));
+    __m256d _radius = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_set1_pd(-2.0),log_approx(_u1)));
+    __m256d _sin, _cos;
+    sincos_2pi_approx(_u2,_sin,_cos);
+    first = _mm256_mul_pd(_radius,_cos);
+    second = _mm256_mul_pd(_radius,_sin);
+}
+
+//runs the four paths in pathIndex through the SIMD recurrence with counter normals, returning terminal prices
+//and log prices; when pathPrices is given every step is stored there as steps x 4. Simulation and replay both
+//go through here so a replayed path matches its first run bit for bit
+void CounterPaths(const uint64_t pathIndex[4], int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT,
+                  uint64_t seed, double finalPrices[4], double finalLogs[4], double* pathPrices = nullptr)
+{
+    __m256d _a = _mm256_mul_pd(_mm256_set1_pd(normalizedStd),_mm256_set1_pd(sqrtDeltaT));
+    __m256d _partialCompVec = _mm256_set1_pd(partialComputation);
+    __m256i _paths = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pathIndex));
+    __m256d _prices = _mm256_set1_pd(startingPrice);
+    __m256d _logReturns = _mm256_setzero_pd();
+    __m256d _normals[2];
+    if(pathPrices){
+        _mm256_storeu_pd(pathPrices,_prices);
+    }
+    for(int j=1; j<steps; ++j){
+        int slot = (j - 1) & 1;
+        if(slot == 0){
+            CounterNormals(_paths, static_cast<uint64_t>(j - 1) >> 1, seed, _normals[0], _normals[1]);
+        }
+        __m256d _c = _mm256_fmadd_pd(_a,_normals[slot],_partialCompVec);
+        _logReturns = _mm256_add_pd(_logReturns,_c);
+        _prices = _mm256_mul_pd(_prices,exp_approx(_c));
+        if(pathPrices){
+            _mm256_storeu_pd(pathPrices + 4 * j,_prices);
+        }
+    }
+    _mm256_storeu_pd(finalPrices,_prices);
+    _mm256_storeu_pd(finalLogs,_mm256_add_pd(_logReturns,_mm256_set1_pd(std::log(startingPrice))));
+}
+
+//the given paths in full, one row per index
+std::vector<std::vector<double>> ReplayPathsData(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, uint64_t seed,
+                                                 const std::vector<int64_t>& pathIndices)
+{
+    double deltaT = 1.0 / steps;
+    double partialComputation = (normalizedMu - 0.5 * normalizedVar) * deltaT;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    std::vector<std::vector<double>> paths;
+    std::vector<double> stepPrices(static_cast<size_t>(steps) * 4);
+    for(size_t i=0; i<pathIndices.size(); i+=4){
+        uint64_t lanes[4];
+        for(size_t k=0; k<4; ++k){
+            lanes[k] = static_cast<uint64_t>(pathIndices[std::min(i + k, pathIndices.size() - 1)]);
+        }
+        double finalPrices[4], finalLogs[4];
+        CounterPaths(lanes, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, seed, finalPrices, finalLogs, stepPrices.data());
+        for(size_t k=0; k<4 && i+k<pathIndices.size(); ++k){
+            std::vector<double> path(steps);
+            for(int j=0; j<steps; ++j){
+                path[j] = stepPrices[4 * j + k];
+            }
+            paths.push_back(std::move(path));
+        }
+    }
+    return paths;
+}
+
+struct QuantilePaths{
+    double averagePrice;
+    std::vector<double> quantiles;
+    std::vector<int64_t> pathIndices;
+    std::vector<double> terminalPrices;
+};
+
+//one pass over all paths that keeps only a terminal sketch plus the lowest path index seen in each bin, then
+//for each quantile the representative of the bin the quantile falls in: its terminal price is within one bin
+//width of the quantile and the choice does not depend on the thread count
+QuantilePaths FindQuantilePathsData(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int totalPaths,
+                                    uint64_t seed, const std::vector<double>& quantiles, int bins, int numThreads)
+{
+    double deltaT = 1.0 / steps;
+    double partialComputation = (normalizedMu - 0.5 * normalizedVar) * deltaT;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    double centre = std::log(startingPrice) + partialComputation * (steps - 1);
+    double halfWidth = 12.0 * normalizedStd * sqrtDeltaT * std::sqrt(static_cast<double>(std::max(steps - 1, 1))) + 1e-9;
+    //bin bins is the underflow, bins + 1 the overflow
+    const int64_t noPath = std::numeric_limits<int64_t>::max();
+
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<TerminalSketch> sketches(numThreads, TerminalSketch(centre - halfWidth, centre + halfWidth, bins, startingPrice));
+    std::vector<std::vector<int64_t>> representatives(numThreads, std::vector<int64_t>(bins + 2, noPath));
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    int64_t firstPath = 0;
+    for(int t=0; t<numThreads; ++t){
+        int numPaths = pathsPerThread + (t < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, t, numPaths, firstPath](){
+            TraceScope trace("worker");
+            TerminalSketch& sketch = sketches[t];
+            std::vector<int64_t>& representative = representatives[t];
+            for(int i=0; i<numPaths; i+=4){
+                uint64_t lanes[4];
+                for(int k=0; k<4; ++k){
+                    lanes[k] = static_cast<uint64_t>(firstPath + std::min(i + k, numPaths - 1));
+                }
+                double finalPrices[4], finalLogs[4];
+                CounterPaths(lanes, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, seed, finalPrices, finalLogs);
+                for(int k=0; k<4 && i+k<numPaths; ++k){
+                    if(!std::isfinite(finalLogs[k])){
+                        //a NaN log passes both range checks below and would cast to an undefined bin
+                        continue;
+                    }
+                    sketch.Add(finalPrices[k], finalLogs[k]);
+                    double position = (finalLogs[k] - sketch.lowerLog) / sketch.binWidth;
+                    size_t bin = position < 0.0 ? bins : position >= bins ? bins + 1 : static_cast<size_t>(position);
+                    //paths arrive in increasing index order within a thread
+                    if(representative[bin] == noPath){
+                        representative[bin] = static_cast<int64_t>(lanes[k]);
+                    }
+                }
+            }
+        });
+        firstPath += numPaths;
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    TerminalSketch& sketch = sketches[0];
+    std::vector<int64_t>& representative = representatives[0];
+    {
+        TraceScope trace("reduce");
+        for(int t=1; t<numThreads; ++t){
+            sketch.Merge(sketches[t]);
+            for(int k=0; k<bins+2; ++k){
+                representative[k] = std::min(representative[k], representatives[t][k]);
+            }
+        }
+    }
+
+    QuantilePaths result;
+    result.averagePrice = sketch.count > 0 ? sketch.sumPrices / sketch.count : startingPrice;
+    result.quantiles = quantiles;
+    if(sketch.count <= 0){
+        return result;
+    }
+    for(double q : quantiles){
+        //same walk as TerminalSketch::Quantile, but returning the bin
+        double target = std::min(std::max(q, 0.0), 1.0) * sketch.count;
+        double cumulative = sketch.belowCount;
+        size_t bin = bins + 1;
+        if(target <= cumulative && sketch.belowCount > 0){
+            bin = bins;
+        }else{
+            for(int k=0; k<bins; ++k){
+                if(cumulative + sketch.counts[k] >= target && sketch.counts[k] > 0){
+                    bin = k;
+                    break;
+                }
+                cumulative += sketch.counts[k];
+            }
+        }
+        if(representative[bin] == noPath){
+            //only reachable for q at the very edge with an empty overflow, fall back to the highest filled bin
+            for(int k=bins-1; k>=0 && representative[bin]==noPath; --k){
+                bin = k;
+            }
+        }
+        result.pathIndices.push_back(representative[bin]);
+    }
+    for(const auto& path : ReplayPathsData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, seed, result.pathIndices)){
+        result.terminalPrices.push_back(path.back());
+    }
+    return result;
+}
+
+py::dict FindQuantilePaths(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int paths, uint64_t seed,
+                           std::vector<double> quantiles, int bins, int numThreads)
+{
+    if(paths < 1 || bins < 1){
+        throw std::invalid_argument("need at least one path and one bin");
+    }
+    QuantilePaths found;
+    {
+        TracedGILRelease release;
+        found = FindQuantilePathsData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, paths, seed, quantiles, bins, numThreads);
+    }
+    py::dict result;
+    result["averagePrice"] = found.averagePrice;
+    result["quantiles"] = found.quantiles;
+    result["pathIndices"] = found.pathIndices;
+    result["terminalPrices"] = found.terminalPrices;
+    return result;
+}
+
+py::array_t<double> ReplayPaths(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, uint64_t seed,
+                                std::vector<int64_t> pathIndices)
+{
+    std::vector<std::vector<double>> paths = ReplayPathsData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, seed, pathIndices);
+    std::vector<double> values;
+    values.reserve(paths.size() * steps);
+    for(const auto& path : paths){
+        values.insert(values.end(), path.begin(), path.end());
+    }
+    return VectorToArray(std::move(values), {static_cast<py::ssize_t>(paths.size()), static_cast<py::ssize_t>(steps)});
+}
+
+//same return type as the other engines, but the display paths are replays of the paths at evenly spaced
+//terminal quantiles rather than the first paths of one thread
+std::pair<std::vector<std::vector<double>>,double> SimulateGBMCounterRNGMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int totalPaths,
+                                                                           uint64_t seed, int displayPaths, int numThreads)
+{
+    std::vector<double> quantiles;
+    for(int i=0; i<displayPaths; ++i){
+        quantiles.push_back((i + 0.5) / displayPaths);
+    }
+    QuantilePaths found = FindQuantilePathsData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths, seed, quantiles, 2048, numThreads);
+    return {ReplayPathsData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, seed, found.pathIndices), found.averagePrice};
+}
+
+py::tuple SimulateGBMCounterRNGMTBinding(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int paths,
+                                         uint64_t seed, int displayPaths, int numThreads)
+{
+    seed = ResolveSeed(seed);
+    std::pair<std::vector<std::vector<double>>, double> result;
+    {
+        TracedGILRelease release;
+        result = SimulateGBMCounterRNGMT(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, paths, seed, displayPaths, numThreads);
+    }
+    return py::make_tuple(result.first, result.second, seed);
+}
+
+struct AdjointSensitivities{
+    double price;
+    double standardError;
+    double delta;
+    double strikeSensitivity;
+    double rateSensitivity;
+    std::vector<double> driftSensitivities;
+    std::vector<double> volSensitivities;
+};
+
+//European call on the GBM recurrence with a per step drift and vol schedule, c_j = (mu_j - vol_j^2 / 2) dt + vol_j sqrt(dt) z_j,
+//and every sensitivity from one reverse sweep per group of four paths. The forward pass tapes (price, growth, z) per step,
+//steps x 4 lanes x 24 bytes, so the tape of a 252 step path stays in L1; the sweep then walks the recurrence backwards:
+//  price_j = price_{j-1} * exp(c_j)  =>  cBar_j = priceBar_j * price_j,  priceBar_{j-1} = priceBar_j * exp(c_j)
+//which costs about as much again as the forward pass no matter how many schedule entries there are.
+//Normals come from the counter based generator, so a bumped rerun with the same seed sees the same paths
+AdjointSensitivities PriceCallAdjointData(double startingPrice, double strike, double rate, const double* drifts, const double* vols, int scheduleSteps,
+                                          int totalPaths, uint64_t seed, int numThreads)
+{
+    int steps = scheduleSteps + 1;
+    double deltaT = 1.0 / steps;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    double discount = std::exp(-rate * scheduleSteps * deltaT);
+
+    struct Partial{
+        double sumPayoff = 0.0, sumSquares = 0.0, sumStartBar = 0.0, sumStrikeBar = 0.0;
+        std::vector<double> driftBar, volBar;
+    };
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<Partial> partials(numThreads);
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    int64_t firstPath = 0;
+    for(int t=0; t<numThreads; ++t){
+        int numPaths = pathsPerThread + (t < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, t, numPaths, firstPath](){
+            TraceScope trace("worker");
+            Partial& partial = partials[t];
+            partial.driftBar.assign(scheduleSteps, 0.0);
+            partial.volBar.assign(scheduleSteps, 0.0);
+            //per step: prices, growth factors and normals of the four lanes
+            std::vector<double> tape(static_cast<size_t>(scheduleSteps) * 12);
+            __m256d _strike = _mm256_set1_pd(strike);
+            __m256d _discount = _mm256_set1_pd(discount);
+            __m256d _sqrtDTVec = _mm256_set1_pd(sqrtDeltaT);
+            __m256d _dtVec = _mm256_set1_pd(deltaT);
+            for(int i=0; i<numPaths; i+=4){
+                alignas(32) uint64_t lanes[4];
+                alignas(32) double weights[4];
+                for(int k=0; k<4; ++k){
+                    lanes[k] = static_cast<uint64_t>(firstPath + std::min(i + k, numPaths - 1));
+                    weights[k] = i + k < numPaths ? 1.0 : 0.0;
+                }
+                __m256i _paths = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+                __m256d _prices = _mm256_set1_pd(startingPrice);
+                __m256d _normals[2];
+                for(int j=0; j<scheduleSteps; ++j){
+                    if((j & 1) == 0){
+                        CounterNormals(_paths, static_cast<uint64_t>(j) >> 1, seed, _normals[0], _normals[1]);
+                    }
+                    __m256d _vol = _mm256_set1_pd(vols[j]);
+                    __m256d _drift = _mm256_set1_pd((drifts[j] - 0.5 * vols[j] * vols[j]) * deltaT);
+                    __m256d _c = _mm256_fmadd_pd(_mm256_mul_pd(_vol,_sqrtDTVec),_normals[j & 1],_drift);
+                    __m256d _growth = exp_approx(_c);
+                    _prices = _mm256_mul_pd(_prices,_growth);
+                    double* entry = tape.data() + 12 * j;
+                    _mm256_storeu_pd(entry,_prices);
+                    _mm256_storeu_pd(entry + 4,_growth);
+                    _mm256_storeu_pd(entry + 8,_normals[j & 1]);
+                }
+                __m256d _weights = _mm256_load_pd(weights);
+                __m256d _inTheMoney = _mm256_and_pd(_mm256_cmp_pd(_prices,_strike,_CMP_GT_OQ),_weights);
+                __m256d _payoff = _mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(_prices,_strike),_inTheMoney),_discount);
+                //reverse sweep, seeded with d payoff / d price_T
+                __m256d _priceBar = _mm256_mul_pd(_inTheMoney,_discount);
+                for(int j=scheduleSteps-1; j>=0; --j){
+                    const double* entry = tape.data() + 12 * j;
+                    __m256d _cBar = _mm256_mul_pd(_priceBar,_mm256_loadu_pd(entry));
+                    //d c / d vol = sqrt(dt) z - vol dt
+                    __m256d _dcdVol = _mm256_fmsub_pd(_sqrtDTVec,_mm256_loadu_pd(entry + 8),_mm256_mul_pd(_mm256_set1_pd(vols[j]),_dtVec));
+                    alignas(32) double cBar[4], volBar[4];
+                    _mm256_store_pd(cBar,_cBar);
+                    _mm256_store_pd(volBar,_mm256_mul_pd(_cBar,_dcdVol));
+                    partial.driftBar[j] += (cBar[0] + cBar[1] + cBar[2] + cBar[3]) * deltaT;
+                    partial.volBar[j] += volBar[0] + volBar[1] + volBar[2] + volBar[3];
+                    _priceBar = _mm256_mul_pd(_priceBar,_mm256_loadu_pd(entry + 4));
+                }
+                alignas(32) double payoff[4], startBar[4], inTheMoney[4];
+                _mm256_store_pd(payoff,_payoff);
+                _mm256_store_pd(startBar,_priceBar);
+                _mm256_store_pd(inTheMoney,_inTheMoney);
+                for(int k=0; k<4; ++k){
+                    partial.sumPayoff += payoff[k];
+                    partial.sumSquares += payoff[k] * payoff[k];
+                    partial.sumStartBar += startBar[k];
+                    partial.sumStrikeBar -= inTheMoney[k] * discount;
+                }
+            }
+        });
+        firstPath += numPaths;
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+
+    TraceScope trace("reduce");
+    AdjointSensitivities result;
+    result.driftSensitivities.assign(scheduleSteps, 0.0);
+    result.volSensitivities.assign(scheduleSteps, 0.0);
+    double sumPayoff = 0.0, sumSquares = 0.0, sumStartBar = 0.0, sumStrikeBar = 0.0;
+    for(const Partial& partial : partials){
+        sumPayoff += partial.sumPayoff;
+        sumSquares += partial.sumSquares;
+        sumStartBar += partial.sumStartBar;
+        sumStrikeBar += partial.sumStrikeBar;
+        for(int j=0; j<scheduleSteps && !partial.driftBar.empty(); ++j){
+            result.driftSensitivities[j] += partial.driftBar[j] / totalPaths;
+            result.volSensitivities[j] += partial.volBar[j] / totalPaths;
+        }
+    }
+    double n = static_cast<double>(totalPaths);
+    result.price = sumPayoff / n;
+    result.standardError = totalPaths > 1 ? std::sqrt(std::max(0.0, sumSquares / n - result.price * result.price) / (n - 1)) : 0.0;
+    result.delta = sumStartBar / n;
+    result.strikeSensitivity = sumStrikeBar / n;
+    //the discount factor is the only place the rate enters
+    result.rateSensitivity = -scheduleSteps * deltaT * result.price;
+    return result;
+}
+
+py::dict PriceCallAdjoint(double startingPrice, double strike, double rate, py::array_t<double, py::array::c_style | py::array::forcecast> drifts,
+                          py::array_t<double, py::array::c_style | py::array::forcecast> vols, int paths, uint64_t seed, int numThreads)
+{
+    if(drifts.size() != vols.size()){
+        throw std::invalid_argument("drifts and vols need one entry per step");
+    }
+    seed = ResolveSeed(seed);
+    AdjointSensitivities sensitivities;
+    {
+        TracedGILRelease release;
+        sensitivities = PriceCallAdjointData(startingPrice, strike, rate, drifts.data(), vols.data(), static_cast<int>(drifts.size()), paths, seed, numThreads);
+    }
+    py::ssize_t n = drifts.size();
+    py::dict result;
+    result["price"] = sensitivities.price;
+    result["standardError"] = sensitivities.standardError;
+    result["delta"] = sensitivities.delta;
+    result["strike"] = sensitivities.strikeSensitivity;
+    result["rate"] = sensitivities.rateSensitivity;
+    result["drifts"] = VectorToArray(std::move(sensitivities.driftSensitivities), {n});
+    result["vols"] = VectorToArray(std::move(sensitivities.volSensitivities), {n});
+    result["seed"] = seed;
+    return result;
+}
+
+//streaming distribution of a signed quantity (P&L): exact moments and extremes plus a fixed range histogram for
+//quantiles and expected shortfall, merged across threads by adding counts
+struct PnLSketch{
+    double lower = 0.0;
+    double binWidth = 1.0;
+    std::vector<double> counts;
+    double belowCount = 0.0, belowSum = 0.0;
+    double aboveCount = 0.0, aboveSum = 0.0;
+    double count = 0.0, sum = 0.0, sumSquares = 0.0;
+    double minimum = std::numeric_limits<double>::infinity();
+    double maximum = -std::numeric_limits<double>::infinity();
+
+    PnLSketch(double lower, double upper, int bins) : lower(lower), binWidth((upper - lower) / bins), counts(bins, 0.0) {}
+
+    void Add(double value){
+        //same guard as TerminalSketch: NaN would index the histogram with garbage
+        if(std::isnan(value)){
+            return;
+        }
+        count += 1.0;
+        sum += value;
+        sumSquares += value * value;
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        double position = (value - lower) / binWidth;
+        if(position < 0.0){
+            belowCount += 1.0;
+            belowSum += value;
+        }else if(position >= counts.size()){
+            aboveCount += 1.0;
+            aboveSum += value;
+        }else{
+            counts[static_cast<size_t>(position)] += 1.0;
+        }
+    }
+
+    void Merge(const PnLSketch& other){
+        for(size_t k=0; k<counts.size(); ++k){
+            counts[k] += other.counts[k];
+        }
+        belowCount += other.belowCount;
+        belowSum += other.belowSum;
+        aboveCount += other.aboveCount;
+        aboveSum += other.aboveSum;
+        count += other.count;
+        sum += other.sum;
+        sumSquares += other.sumSquares;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+    }
+
+    //inverse cdf, linear inside a bin
+    double Quantile(double q) const {
+        double target = q * count;
+        double cumulative = belowCount;
+        if(target <= cumulative){
+            return belowCount > 0 ? belowSum / belowCount : lower;
+        }
+        for(size_t k=0; k<counts.size(); ++k){
+            if(cumulative + counts[k] >= target && counts[k] > 0){
+                return lower + (k + (target - cumulative) / counts[k]) * binWidth;
+            }
+            cumulative += counts[k];
+        }
+        return aboveCount > 0 ? aboveSum / aboveCount : lower + counts.size() * binWidth;
+    }
+
+    //mean of the worst (1 - level) share of outcomes, bins taken at their centres
+    double ExpectedShortfall(double level) const {
+        double tailCount = (1.0 - level) * count;
+        if(tailCount <= 0.0){
+            return minimum;
+        }
+        double taken = std::min(belowCount, tailCount);
+        double tailSum = belowCount > 0 ? belowSum / belowCount * taken : 0.0;
+        for(size_t k=0; k<counts.size() && taken<tailCount; ++k){
+            double share = std::min(counts[k], tailCount - taken);
+            tailSum += share * (lower + (k + 0.5) * binWidth);
+            taken += share;
+        }
+        if(taken < tailCount && aboveCount > 0){
+            tailSum += (tailCount - taken) * aboveSum / aboveCount;
+            taken = tailCount;
+        }
+        return tailSum / taken;
+    }
+};
+
+struct HedgeStatistics{
+    double premium;
+    double mean;
+    double deviation;
+    double minimum;
+    double maximum;
+    std::vector<double> quantiles;
+    std::vector<double> quantileValues;
+    double expectedShortfall95;
+    double expectedShortfall99;
+    double averageTurnover;
+    double averageCosts;
+};
+
+double BlackScholesCall(double price, double strike, double rate, double vol, double tau){
+    double d1 = (std::log(price / strike) + (rate + 0.5 * vol * vol) * tau) / (vol * std::sqrt(tau));
+    double d2 = d1 - vol * std::sqrt(tau);
+    return price * 0.5 * std::erfc(-d1 / std::sqrt(2.0)) - strike * std::exp(-rate * tau) * 0.5 * std::erfc(-d2 / std::sqrt(2.0));
+}
+
+//P&L of selling a European call at its Black-Scholes price and delta hedging it every rebalanceSteps steps with
+//proportional transaction costs, cash accruing at the rate; paths follow the usual recurrence, the hedge uses
+//hedgeVol so model error can be studied. Paths are never stored: each group of four paths draws its normals as one
+//tile, runs price, delta, cash and costs in registers and folds the lanes' P&L into a per thread sketch
+HedgeStatistics SimulateHedgePnLData(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int totalPaths,
+                                     double strike, double rate, double hedgeVol, int rebalanceSteps, double costRate, int bins, int numThreads)
+{
+    double deltaT = 1.0 / steps;
+    double partialComputation = (normalizedMu - 0.5 * normalizedVar) * deltaT;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    double maturity = (steps - 1) * deltaT;
+    rebalanceSteps = std::max(1, rebalanceSteps);
+    double premium = BlackScholesCall(startingPrice, strike, rate, hedgeVol, maturity);
+    //an unhedged short call loses at most about the terminal price, four terminal deviations bound the hedged error
+    double range = 4.0 * startingPrice * std::max(normalizedStd, hedgeVol) * std::sqrt(maturity) + premium;
+    //per step Black-Scholes constants, indexed by the step the hedge is set at
+    std::vector<double> volRootTau(steps), driftTau(steps);
+    for(int j=0; j<steps; ++j){
+        double tau = maturity - j * deltaT;
+        volRootTau[j] = hedgeVol * std::sqrt(tau);
+        driftTau[j] = (rate + 0.5 * hedgeVol * hedgeVol) * tau;
+    }
+
+    struct Partial{
+        PnLSketch sketch;
+        double turnover = 0.0, costs = 0.0;
+    };
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<Partial> partials(numThreads, Partial{PnLSketch(-range, range, bins)});
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    for(int t=0; t<numThreads; ++t){
+        int numPaths = pathsPerThread + (t < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, t, numPaths](){
+            TraceScope trace("worker");
+            Partial& partial = partials[t];
+            std::random_device rd;
+            SIMDNormalGenerator generator((static_cast<uint64_t>(rd()) << 32) | rd());
+            //steps - 1 normals per lane, rounded up to an even count for Fill
+            int tileSteps = steps & ~1;
+            std::vector<double> storage(static_cast<size_t>(tileSteps) * 4 + 4);
+            double* tile = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+            __m256d _a = _mm256_set1_pd(normalizedStd * sqrtDeltaT);
+            __m256d _partialCompVec = _mm256_set1_pd(partialComputation);
+            __m256d _strike = _mm256_set1_pd(strike);
+            __m256d _logStrike = _mm256_set1_pd(std::log(strike));
+            __m256d _carry = _mm256_set1_pd(std::exp(rate * deltaT));
+            __m256d _cost = _mm256_set1_pd(costRate);
+            __m256d _absMask = _mm256_set1_pd(-0.0);
+            for(int i=0; i<numPaths; i+=4){
+                if(tileSteps > 0){
+                    generator.Fill(tile, static_cast<size_t>(tileSteps) * 4);
+                }
+                __m256d _prices = _mm256_set1_pd(startingPrice);
+                double startDelta = 0.5 * std::erfc(-(std::log(startingPrice / strike) + driftTau[0]) / volRootTau[0] / std::sqrt(2.0));
+                __m256d _delta = _mm256_set1_pd(startDelta);
+                __m256d _turnover = _mm256_set1_pd(startDelta * startingPrice);
+                __m256d _costs = _mm256_mul_pd(_turnover,_cost);
+                __m256d _cash = _mm256_set1_pd(premium - startDelta * startingPrice - costRate * startDelta * startingPrice);
+                for(int j=1; j<steps; ++j){
+                    __m256d _c = _mm256_fmadd_pd(_a,_mm256_load_pd(tile + 4 * (j - 1)),_partialCompVec);
+                    _prices = _mm256_mul_pd(_prices,exp_approx(_c));
+                    _cash = _mm256_mul_pd(_cash,_carry);
+                    if(j % rebalanceSteps != 0 || j == steps - 1){
+                        continue;
+                    }
+                    //delta = N(d1), d1 = (ln(S / K) + (r + vol^2 / 2) tau) / (vol sqrt(tau))
+                    __m256d _d1 = _mm256_div_pd(_mm256_add_pd(_mm256_sub_pd(log_approx(_prices),_logStrike),_mm256_set1_pd(driftTau[j])),_mm256_set1_pd(volRootTau[j]));
+                    __m256d _newDelta = normcdf_approx(_d1);
+                    __m256d _traded = _mm256_mul_pd(_mm256_andnot_pd(_absMask,_mm256_sub_pd(_newDelta,_delta)),_prices);
+                    _cash = _mm256_fnmadd_pd(_mm256_sub_pd(_newDelta,_delta),_prices,_cash);
+                    _cash = _mm256_fnmadd_pd(_traded,_cost,_cash);
+                    _turnover = _mm256_add_pd(_turnover,_traded);
+                    _costs = _mm256_fmadd_pd(_traded,_cost,_costs);
+                    _delta = _newDelta;
+                }
+                //the shares are marked at the terminal price and the call settles
+                __m256d _payoff = _mm256_max_pd(_mm256_sub_pd(_prices,_strike),_mm256_setzero_pd());
+                __m256d _pnl = _mm256_sub_pd(_mm256_fmadd_pd(_delta,_prices,_cash),_payoff);
+                alignas(32) double pnl[4], turnover[4], costs[4];
+                _mm256_store_pd(pnl,_pnl);
+                _mm256_store_pd(turnover,_turnover);
+                _mm256_store_pd(costs,_costs);
+                for(int k=0; k<4 && i+k<numPaths; ++k){
+                    partial.sketch.Add(pnl[k]);
+                    partial.turnover += turnover[k];
+                    partial.costs += costs[k];
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    TraceScope trace("reduce");
+    Partial& total = partials[0];
+    for(int t=1; t<numThreads; ++t){
+        total.sketch.Merge(partials[t].sketch);
+        total.turnover += partials[t].turnover;
+        total.costs += partials[t].costs;
+    }
+
+    const PnLSketch& sketch = total.sketch;
+    HedgeStatistics stats;
+    stats.premium = premium;
+    stats.mean = sketch.sum / sketch.count;
+    stats.deviation = std::sqrt(std::max(0.0, sketch.sumSquares / sketch.count - stats.mean * stats.mean));
+    stats.minimum = sketch.minimum;
+    stats.maximum = sketch.maximum;
+    stats.quantiles = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+    for(double q : stats.quantiles){
+        stats.quantileValues.push_back(sketch.Quantile(q));
+    }
+    stats.expectedShortfall95 = sketch.ExpectedShortfall(0.95);
+    stats.expectedShortfall99 = sketch.ExpectedShortfall(0.99);
+    stats.averageTurnover = total.turnover / sketch.count;
+    stats.averageCosts = total.costs / sketch.count;
+    return stats;
+}
+
+py::dict SimulateHedgePnL(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int paths, double strike, double rate,
+                          double hedgeVol, int rebalanceSteps, double costRate, int bins, int numThreads)
+{
+    if(paths <= 0 || steps < 2){
+        throw std::invalid_argument("need at least one path and two steps");
+    }
+    if(hedgeVol <= 0.0){
+        hedgeVol = normalizedStd;
+    }
+    HedgeStatistics stats;
+    {
+        TracedGILRelease release;
+        stats = SimulateHedgePnLData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, paths, strike, rate, hedgeVol, rebalanceSteps, costRate, bins, numThreads);
+    }
+    py::dict result;
+    result["premium"] = stats.premium;
+    result["mean"] = stats.mean;
+    result["deviation"] = stats.deviation;
+    result["minimum"] = stats.minimum;
+    result["maximum"] = stats.maximum;
+    result["quantiles"] = stats.quantiles;
+    result["quantileValues"] = stats.quantileValues;
+    result["expectedShortfall95"] = stats.expectedShortfall95;
+    result["expectedShortfall99"] = stats.expectedShortfall99;
+    result["averageTurnover"] = stats.averageTurnover;
+    result["averageCosts"] = stats.averageCosts;
+    return result;
+}
+
+//lower triangular L with L L^T = matrix (row major n x n), false when the matrix is not positive definite
+bool CholeskyFactor(const double* matrix, size_t n, std::vector<double>& lower){
+    lower.assign(n * n, 0.0);
+    for(size_t i=0; i<n; ++i){
+        for(size_t j=0; j<=i; ++j){
+            double sum = matrix[i * n + j];
+            for(size_t k=0; k<j; ++k){
+                sum -= lower[i * n + k] * lower[j * n + k];
+            }
+            if(i == j){
+                if(!(sum > 0.0)){
+                    return false;
+                }
+                lower[i * n + i] = std::sqrt(sum);
+            }else{
+                lower[i * n + j] = sum / lower[j * n + j];
+            }
+        }
+    }
+    return true;
+}
+
+enum RebalanceStrategy{ buyAndHold = 0, constantMix = 1, thresholdBand = 2, strategyCount = 3 };
+const char* const rebalanceStrategyNames[strategyCount] = {"buyAndHold", "constantMix", "threshold"};
+
+struct StrategyStatistics{
+    PnLSketch wealth;
+    PnLSketch drawdown;
+    double turnover = 0.0;
+    double costs = 0.0;
+    double rebalances = 0.0;
+};
+
+//terminal wealth, maximum drawdown and turnover of buy-and-hold, constant-mix (every rebalanceSteps steps) and
+//threshold (whenever a weight leaves target +- band) portfolios, all starting from wealth 1 at the target weights
+//and run side by side on the same correlated paths. Each group of four paths keeps the holdings of every strategy
+//and asset in lanes, shocks are Cholesky mixed normals, rebalancing costs costRate per unit traded
+std::vector<StrategyStatistics> BacktestRebalancingData(const double* normalizedMu, const double* normalizedVar, const double* normalizedStd, const double* correlation,
+                                                        const double* targetWeights, size_t numAssets, int steps, int totalPaths, int rebalanceSteps,
+                                                        double band, double costRate, int bins, int numThreads)
+{
+    size_t n = numAssets;
+    std::vector<double> cholesky;
+    if(!CholeskyFactor(correlation, n, cholesky)){
+        throw std::invalid_argument("correlation matrix must be positive definite");
+    }
+    double deltaT = 1.0 / steps;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    rebalanceSteps = std::max(1, rebalanceSteps);
+    //wealth histogram up to eight terminal deviations above the best asset
+    double upperLog = 0.0;
+    for(size_t i=0; i<n; ++i){
+        double partial = (normalizedMu[i] - 0.5 * normalizedVar[i]) * deltaT;
+        upperLog = std::max(upperLog, partial * (steps - 1) + 8.0 * normalizedStd[i] * sqrtDeltaT * std::sqrt(static_cast<double>(steps - 1)));
+    }
+    double upperWealth = std::exp(upperLog);
+
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<std::vector<StrategyStatistics>> partials(numThreads,
+        std::vector<StrategyStatistics>(strategyCount, StrategyStatistics{PnLSketch(0.0, upperWealth, bins), PnLSketch(0.0, 1.0, bins)}));
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    for(int t=0; t<numThreads; ++t){
+        int numPaths = pathsPerThread + (t < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, t, numPaths](){
+            TraceScope trace("worker");
+            std::random_device rd;
+            SIMDNormalGenerator generator((static_cast<uint64_t>(rd()) << 32) | rd());
+            //one step of normals for every asset and lane, rounded up to the 8 doubles Fill works in
+            size_t normalsPerStep = (n * 4 + 7) & ~static_cast<size_t>(7);
+            //normals, per asset step drifts/scales, then holdings, peaks and drawdowns per strategy, all 4 lanes wide
+            size_t holdingsOffset = normalsPerStep;
+            size_t stateOffset = holdingsOffset + strategyCount * n * 4;
+            std::vector<double> storage(stateOffset + strategyCount * 12 + 4);
+            double* base = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+            double* normals = base;
+            double* holdings = base + holdingsOffset;
+            double* peaks = base + stateOffset;
+            double* drawdowns = peaks + strategyCount * 4;
+            double* turnovers = drawdowns + strategyCount * 4;
+            std::vector<double> partialComputation(n), scale(n);
+            for(size_t i=0; i<n; ++i){
+                partialComputation[i] = (normalizedMu[i] - 0.5 * normalizedVar[i]) * deltaT;
+                scale[i] = normalizedStd[i] * sqrtDeltaT;
+            }
+            __m256d _cost = _mm256_set1_pd(costRate);
+            __m256d _band = _mm256_set1_pd(band);
+            __m256d _absMask = _mm256_set1_pd(-0.0);
+            std::vector<StrategyStatistics>& stats = partials[t];
+            alignas(32) double rebalanceCounts[strategyCount][4];
+            alignas(32) double costTotals[strategyCount][4];
+
+            //moves the masked lanes of a strategy back to the target weights, paying costs out of wealth
+            auto Rebalance = [&](int strategy, __m256d _mask){
+                double* h = holdings + strategy * n * 4;
+                __m256d _wealth = _mm256_setzero_pd();
+                for(size_t i=0; i<n; ++i){
+                    _wealth = _mm256_add_pd(_wealth,_mm256_load_pd(h + 4 * i));
+                }
+                __m256d _traded = _mm256_setzero_pd();
+                for(size_t i=0; i<n; ++i){
+                    __m256d _target = _mm256_mul_pd(_wealth,_mm256_set1_pd(targetWeights[i]));
+                    _traded = _mm256_add_pd(_traded,_mm256_andnot_pd(_absMask,_mm256_sub_pd(_target,_mm256_load_pd(h + 4 * i))));
+                }
+                _traded = _mm256_and_pd(_traded,_mask);
+                __m256d _paid = _mm256_mul_pd(_traded,_cost);
+                __m256d _after = _mm256_sub_pd(_wealth,_paid);
+                for(size_t i=0; i<n; ++i){
+                    __m256d _target = _mm256_mul_pd(_after,_mm256_set1_pd(targetWeights[i]));
+                    _mm256_store_pd(h + 4 * i,_mm256_blendv_pd(_mm256_load_pd(h + 4 * i),_target,_mask));
+                }
+                double* turnover = turnovers + strategy * 4;
+                _mm256_store_pd(turnover,_mm256_add_pd(_mm256_load_pd(turnover),_mm256_div_pd(_traded,_wealth)));
+                _mm256_store_pd(costTotals[strategy],_mm256_add_pd(_mm256_load_pd(costTotals[strategy]),_paid));
+                _mm256_store_pd(rebalanceCounts[strategy],_mm256_add_pd(_mm256_load_pd(rebalanceCounts[strategy]),_mm256_and_pd(_mask,_mm256_set1_pd(1.0))));
+            };
+
+            for(int p=0; p<numPaths; p+=4){
+                for(int strategy=0; strategy<strategyCount; ++strategy){
+                    for(size_t i=0; i<n; ++i){
+                        _mm256_store_pd(holdings + (strategy * n + i) * 4,_mm256_set1_pd(targetWeights[i]));
+                    }
+                    _mm256_store_pd(peaks + strategy * 4,_mm256_set1_pd(1.0));
+                    _mm256_store_pd(drawdowns + strategy * 4,_mm256_setzero_pd());
+                    _mm256_store_pd(turnovers + strategy * 4,_mm256_setzero_pd());
+                    _mm256_store_pd(rebalanceCounts[strategy],_mm256_setzero_pd());
+                    _mm256_store_pd(costTotals[strategy],_mm256_setzero_pd());
+                }
+                for(int j=1; j<steps; ++j){
+                    generator.Fill(normals, normalsPerStep);
+                    //growth of each asset from its correlated shock, applied to every strategy's holding
+                    for(size_t i=0; i<n; ++i){
+                        __m256d _shock = _mm256_setzero_pd();
+                        for(size_t k=0; k<=i; ++k){
+                            _shock = _mm256_fmadd_pd(_mm256_set1_pd(cholesky[i * n + k]),_mm256_load_pd(normals + 4 * k),_shock);
+                        }
+                        __m256d _growth = exp_approx(_mm256_fmadd_pd(_mm256_set1_pd(scale[i]),_shock,_mm256_set1_pd(partialComputation[i])));
+                        for(int strategy=0; strategy<strategyCount; ++strategy){
+                            double* h = holdings + (strategy * n + i) * 4;
+                            _mm256_store_pd(h,_mm256_mul_pd(_mm256_load_pd(h),_growth));
+                        }
+                    }
+                    if(j % rebalanceSteps == 0 && j < steps - 1){
+                        Rebalance(constantMix, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+                    }
+                    if(j < steps - 1){
+                        double* h = holdings + thresholdBand * n * 4;
+                        __m256d _wealth = _mm256_setzero_pd();
+                        for(size_t i=0; i<n; ++i){
+                            _wealth = _mm256_add_pd(_wealth,_mm256_load_pd(h + 4 * i));
+                        }
+                        __m256d _outside = _mm256_setzero_pd();
+                        for(size_t i=0; i<n; ++i){
+                            __m256d _drift = _mm256_sub_pd(_mm256_div_pd(_mm256_load_pd(h + 4 * i),_wealth),_mm256_set1_pd(targetWeights[i]));
+                            _outside = _mm256_or_pd(_outside,_mm256_cmp_pd(_mm256_andnot_pd(_absMask,_drift),_band,_CMP_GT_OQ));
+                        }
+                        if(_mm256_movemask_pd(_outside)){
+                            Rebalance(thresholdBand, _outside);
+                        }
+                    }
+                    //running peak and deepest drawdown of each strategy's wealth
+                    for(int strategy=0; strategy<strategyCount; ++strategy){
+                        double* h = holdings + strategy * n * 4;
+                        __m256d _wealth = _mm256_setzero_pd();
+                        for(size_t i=0; i<n; ++i){
+                            _wealth = _mm256_add_pd(_wealth,_mm256_load_pd(h + 4 * i));
+                        }
+                        __m256d _peak = _mm256_max_pd(_mm256_load_pd(peaks + strategy * 4),_wealth);
+                        __m256d _drawdown = _mm256_sub_pd(_mm256_set1_pd(1.0),_mm256_div_pd(_wealth,_peak));
+                        _mm256_store_pd(peaks + strategy * 4,_peak);
+                        _mm256_store_pd(drawdowns + strategy * 4,_mm256_max_pd(_mm256_load_pd(drawdowns + strategy * 4),_drawdown));
+                    }
+                }
+                for(int strategy=0; strategy<strategyCount; ++strategy){
+                    const double* h = holdings + strategy * n * 4;
+                    for(int k=0; k<4 && p+k<numPaths; ++k){
+                        double wealth = 0.0;
+                        for(size_t i=0; i<n; ++i){
+                            wealth += h[4 * i + k];
+                        }
+                        stats[strategy].wealth.Add(wealth);
+                        stats[strategy].drawdown.Add(drawdowns[strategy * 4 + k]);
+                        stats[strategy].turnover += turnovers[strategy * 4 + k];
+                        stats[strategy].costs += costTotals[strategy][k];
+                        stats[strategy].rebalances += rebalanceCounts[strategy][k];
+                    }
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    TraceScope trace("reduce");
+    std::vector<StrategyStatistics>& totals = partials[0];
+    for(int t=1; t<numThreads; ++t){
+        for(int strategy=0; strategy<strategyCount; ++strategy){
+            totals[strategy].wealth.Merge(partials[t][strategy].wealth);
+            totals[strategy].drawdown.Merge(partials[t][strategy].drawdown);
+            totals[strategy].turnover += partials[t][strategy].turnover;
+            totals[strategy].costs += partials[t][strategy].costs;
+            totals[strategy].rebalances += partials[t][strategy].rebalances;
+        }
+    }
+    return totals;
+}
+
+py::dict BacktestRebalancing(py::array_t<double, py::array::c_style | py::array::forcecast> normalizedMu,
+                             py::array_t<double, py::array::c_style | py::array::forcecast> normalizedVar,
+                             py::array_t<double, py::array::c_style | py::array::forcecast> normalizedStd,
+                             py::array_t<double, py::array::c_style | py::array::forcecast> correlation,
+                             py::array_t<double, py::array::c_style | py::array::forcecast> targetWeights,
+                             int steps, int paths, int rebalanceSteps, double band, double costRate, int bins, int numThreads)
+{
+    size_t numAssets = static_cast<size_t>(targetWeights.size());
+    if(normalizedMu.size() != targetWeights.size() || normalizedVar.size() != targetWeights.size() || normalizedStd.size() != targetWeights.size()){
+        throw std::invalid_argument("parameter arrays must all have one entry per asset");
+    }
+    if(correlation.ndim() != 2 || correlation.shape(0) != targetWeights.size() || correlation.shape(1) != targetWeights.size()){
+        throw std::invalid_argument("correlation must be an (assets x assets) array");
+    }
+    if(paths <= 0 || steps < 2){
+        throw std::invalid_argument("need at least one path and two steps");
+    }
+    //every strategy starts from wealth 1 (peaks included), so the weights must be a long only allocation of it
+    double weightSum = 0.0;
+    for(py::ssize_t i=0; i<targetWeights.size(); ++i){
+        double weight = targetWeights.data()[i];
+        if(!(weight >= 0.0) || !std::isfinite(weight)){
+            throw std::invalid_argument("targetWeights must be finite and non negative");
+        }
+        weightSum += weight;
+    }
+    if(std::fabs(weightSum - 1.0) > 1e-6){
+        throw std::invalid_argument("targetWeights must sum to one (got " + std::to_string(weightSum) + ")");
+    }
+    std::vector<StrategyStatistics> stats;
+    {
+        TracedGILRelease release;
+        stats = BacktestRebalancingData(normalizedMu.data(), normalizedVar.data(), normalizedStd.data(), correlation.data(), targetWeights.data(), numAssets,
+                                        steps, paths, rebalanceSteps, band, costRate, bins, numThreads);
+    }
+    std::vector<double> quantiles = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+    py::dict result;
+    for(int strategy=0; strategy<strategyCount; ++strategy){
+        const StrategyStatistics& stat = stats[strategy];
+        double count = stat.wealth.count;
+        double meanWealth = stat.wealth.sum / count;
+        double meanDrawdown = stat.drawdown.sum / count;
+        std::vector<double> wealthQuantiles, drawdownQuantiles;
+        for(double q : quantiles){
+            wealthQuantiles.push_back(stat.wealth.Quantile(q));
+            drawdownQuantiles.push_back(stat.drawdown.Quantile(q));
+        }
+        py::dict summary;
+        summary["meanWealth"] = meanWealth;
+        summary["wealthDeviation"] = std::sqrt(std::max(0.0, stat.wealth.sumSquares / count - meanWealth * meanWealth));
+        summary["quantiles"] = quantiles;
+        summary["wealthQuantiles"] = wealthQuantiles;
+        summary["wealthShortfall95"] = stat.wealth.ExpectedShortfall(0.95);
+        summary["meanMaxDrawdown"] = meanDrawdown;
+        summary["maxDrawdownQuantiles"] = drawdownQuantiles;
+        summary["worstMaxDrawdown"] = stat.drawdown.maximum;
+        summary["meanTurnover"] = stat.turnover / count;
+        summary["meanCosts"] = stat.costs / count;
+        summary["meanRebalances"] = stat.rebalances / count;
+        result[rebalanceStrategyNames[strategy]] = summary;
+    }
+    return result;
+}
+
+//Gamma(shape, 1) on four lanes by Marsaglia-Tsang with masked rejection. Fill draws one branch free candidate per
+//lane for a whole tile, so the log chains of different vectors overlap, then packs the rejected lanes (a few
+//percent) four to a vector and redraws them the same way until none are left. Shapes below one are boosted,
+//Gamma(a) = Gamma(a + 1) U^(1 / a), which is what the tiny per step shapes of a Levy subordinator need
+struct SIMDGammaGenerator{
+    SIMDNormalGenerator generator;
+    double shape;
+    double d, c;
+    alignas(32) double normals[64];
+    int nextNormal = 64;
+    std::vector<size_t> rejected, stillRejected;
+
+    SIMDGammaGenerator(uint64_t seed, double shape) : generator(seed), shape(shape) {
+        d = (shape < 1.0 ? shape + 1.0 : shape) - 1.0 / 3.0;
+        c = 1.0 / std::sqrt(9.0 * d);
+    }
+
+    __m256d NextNormal(){
+        if(nextNormal == 64){
+            generator.Fill(normals, 64);
+            nextNormal = 0;
+        }
+        __m256d _normal = _mm256_load_pd(normals + nextNormal);
+        nextNormal += 4;
+        return _normal;
+    }
+
+    //one Marsaglia-Tsang round: d v as the candidate, accept set where ln U < x^2 / 2 + d - d v + d ln v with v > 0
+    __m256d Candidate(__m256d _x, __m256d& _accept){
+        __m256d _one = _mm256_set1_pd(1.0);
+        __m256d _d = _mm256_set1_pd(d);
+        __m256d _base = _mm256_fmadd_pd(_mm256_set1_pd(c),_x,_one);
+        __m256d _v = _mm256_mul_pd(_mm256_mul_pd(_base,_base),_base);
+        __m256d _positive = _mm256_cmp_pd(_v,_mm256_setzero_pd(),_CMP_GT_OQ);
+        __m256d _u = _mm256_sub_pd(_one,generator.NextUniform());
+        //the squeeze U < 1 - 0.0331 x^4 settles all four lanes without a log most of the time
+        __m256d _x2 = _mm256_mul_pd(_x,_x);
+        _accept = _mm256_and_pd(_positive,_mm256_cmp_pd(_u,_mm256_fnmadd_pd(_mm256_mul_pd(_x2,_x2),_mm256_set1_pd(0.0331),_one),_CMP_LT_OQ));
+        if(_mm256_movemask_pd(_accept) != 0xF){
+            //v clamped so the log stays finite on lanes that are rejected anyway
+            __m256d _logV = log_approx(_mm256_max_pd(_v,_mm256_set1_pd(1e-300)));
+            __m256d _bound = _mm256_fmadd_pd(_x2,_mm256_set1_pd(0.5),_mm256_mul_pd(_d,_mm256_add_pd(_mm256_sub_pd(_one,_v),_logV)));
+            _accept = _mm256_and_pd(_positive,_mm256_cmp_pd(log_approx(_u),_bound,_CMP_LT_OQ));
+        }
+        return _mm256_mul_pd(_d,_v);
+    }
+
+    //count must be a multiple of 8 and out 32 byte aligned
+    void Fill(double* out, size_t count){
+        generator.Fill(out, count);
+        rejected.clear();
+        for(size_t i=0; i<count; i+=4){
+            __m256d _accept;
+            _mm256_store_pd(out + i,Candidate(_mm256_load_pd(out + i),_accept));
+            int accepted = _mm256_movemask_pd(_accept);
+            for(int k=0; k<4 && accepted!=0xF; ++k){
+                if(!(accepted & (1 << k))){
+                    rejected.push_back(i + k);
+                }
+            }
+        }
+        while(!rejected.empty()){
+            stillRejected.clear();
+            for(size_t r=0; r<rejected.size(); r+=4){
+                __m256d _accept;
+                alignas(32) double candidates[4];
+                _mm256_store_pd(candidates,Candidate(NextNormal(),_accept));
+                int accepted = _mm256_movemask_pd(_accept);
+                for(size_t k=0; k<4 && r+k<rejected.size(); ++k){
+                    if(accepted & (1 << k)){
+                        out[rejected[r + k]] = candidates[k];
+                    }else{
+                        stillRejected.push_back(rejected[r + k]);
+                    }
+                }
+            }
+            rejected.swap(stillRejected);
+        }
+        if(shape < 1.0){
+            __m256d _one = _mm256_set1_pd(1.0);
+            __m256d _inverseShape = _mm256_set1_pd(1.0 / shape);
+            for(size_t i=0; i<count; i+=4){
+                __m256d _logU = log_approx(_mm256_sub_pd(_one,generator.NextUniform()));
+                _mm256_store_pd(out + i,_mm256_mul_pd(_mm256_load_pd(out + i),exp_full_approx(_mm256_mul_pd(_logU,_inverseShape))));
+            }
+        }
+    }
+};
+
+//unit variance Student-t shocks z / sqrt(chi2 / dof) * sqrt((dof - 2) / dof) with chi2 = 2 Gamma(dof / 2), so each
+//shock costs one normal and one gamma draw whatever the degrees of freedom (above 2)
+struct StudentTShocks{
+    SIMDNormalGenerator generator;
+    SIMDGammaGenerator gammas;
+    double degreesOfFreedom;
+    std::vector<double> storage;
+
+    StudentTShocks(uint64_t seed, double degreesOfFreedom)
+        : generator(seed), gammas(SubstreamSeed(seed, 1), 0.5 * degreesOfFreedom), degreesOfFreedom(degreesOfFreedom) {}
+
+    //count must be a multiple of 8 and out 32 byte aligned
+    void Fill(double* out, size_t count){
+        if(storage.size() < count + 4){
+            storage.resize(count + 4);
+        }
+        double* halfChi = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+        gammas.Fill(halfChi, count);
+        generator.Fill(out, count);
+        //z sqrt(dof / chi) sqrt((dof - 2) / dof) = z sqrt((dof - 2) / (2 gamma))
+        __m256d _halfScale = _mm256_set1_pd(0.5 * (degreesOfFreedom - 2.0));
+        for(size_t i=0; i<count; i+=4){
+            __m256d _ratio = _mm256_div_pd(_halfScale,_mm256_load_pd(halfChi + i));
+            _mm256_store_pd(out + i,_mm256_mul_pd(_mm256_load_pd(out + i),_mm256_sqrt_pd(_ratio)));
+        }
+    }
+};
+
+//Normal-Inverse-Gaussian shape (alpha, beta, delta), location free since the shocks are standardised
+struct NIGParameters{
+    double alpha;
+    double beta;
+    double delta;
+    double mu;
+};
+
+//unit variance NIG shocks: V ~ IG(delta / gamma, delta^2) by Michael-Schucany-Haas with the root choice as a blend,
+//X = beta V + sqrt(V) z, then centred and scaled by the exact NIG mean and deviation
+struct NIGShocks{
+    SIMDNormalGenerator generator;
+    double mean, shape, beta, centre, inverseDeviation;
+    alignas(32) double normals[16];
+
+    NIGShocks(uint64_t seed, const NIGParameters& parameters) : generator(seed) {
+        double gamma = std::sqrt(parameters.alpha * parameters.alpha - parameters.beta * parameters.beta);
+        mean = parameters.delta / gamma;
+        shape = parameters.delta * parameters.delta;
+        beta = parameters.beta;
+        centre = parameters.delta * parameters.beta / gamma;
+        inverseDeviation = 1.0 / std::sqrt(parameters.delta * parameters.alpha * parameters.alpha / (gamma * gamma * gamma));
+    }
+
+    //count must be a multiple of 8 and out 32 byte aligned
+    void Fill(double* out, size_t count){
+        __m256d _m = _mm256_set1_pd(mean);
+        __m256d _halfMOverShape = _mm256_set1_pd(0.5 * mean / shape);
+        __m256d _fourShape = _mm256_set1_pd(4.0 * shape);
+        __m256d _beta = _mm256_set1_pd(beta);
+        __m256d _centre = _mm256_set1_pd(centre);
+        __m256d _inverseDeviation = _mm256_set1_pd(inverseDeviation);
+        for(size_t i=0; i<count; i+=8){
+            generator.Fill(normals, 16);
+            for(int half=0; half<8; half+=4){
+                __m256d _n = _mm256_load_pd(normals + half);
+                __m256d _y = _mm256_mul_pd(_mm256_mul_pd(_n,_n),_m);
+                //x = m + (m / 2 shape) (m y - sqrt(4 m shape y + m^2 y^2)) with y already scaled by m
+                __m256d _root = _mm256_sqrt_pd(_mm256_fmadd_pd(_y,_y,_mm256_mul_pd(_fourShape,_y)));
+                __m256d _x = _mm256_fmadd_pd(_halfMOverShape,_mm256_sub_pd(_y,_root),_m);
+                __m256d _other = _mm256_div_pd(_mm256_mul_pd(_m,_m),_x);
+                __m256d _takeX = _mm256_cmp_pd(_mm256_mul_pd(generator.NextUniform(),_mm256_add_pd(_m,_x)),_m,_CMP_LE_OQ);
+                __m256d _v = _mm256_blendv_pd(_other,_x,_takeX);
+                __m256d _z = _mm256_load_pd(normals + 8 + half);
+                __m256d _shock = _mm256_fmadd_pd(_mm256_sqrt_pd(_v),_z,_mm256_mul_pd(_beta,_v));
+                _mm256_store_pd(out + i + half,_mm256_mul_pd(_mm256_sub_pd(_shock,_centre),_inverseDeviation));
+            }
+        }
+    }
+};
+
+//CalculateSIMDPathsBlockRNG with any shock generator filling the tile (4 interleaved groups of 4 paths); heavy tails
+//can push a step past the range of exp_approx, so the price update uses exp_full_approx
+template<typename Shocks>
+double CalculateSIMDPathsShocks(int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT, Shocks& shocks)
+{
+    constexpr int streams = 4;
+    constexpr int lanes = 4 * streams;
+    int blockSteps = std::max(1, rngBlockSteps.load());
+    __m256d _a = _mm256_mul_pd(_mm256_set1_pd(normalizedStd),_mm256_set1_pd(sqrtDeltaT));
+    __m256d _partialCompVec = _mm256_set1_pd(partialComputation);
+    std::vector<double> storage(static_cast<size_t>(blockSteps) * lanes + 4);
+    double* tile = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+    double sumFinalPrices = 0;
+    for(int i=0; i<numPaths; i+=lanes){
+        __m256d _prices[streams];
+        for(int s=0; s<streams; ++s){
+            _prices[s] = _mm256_set1_pd(startingPrice);
+        }
+        for(int blockStart=1; blockStart<steps; blockStart+=blockSteps){
+            int blockLength = std::min(blockSteps, steps - blockStart);
+            {
+                TraceScope trace("rngBlock");
+                shocks.Fill(tile, static_cast<size_t>(blockLength) * lanes);
+            }
+            TraceScope trace("priceUpdate");
+            for(int j=0; j<blockLength; ++j){
+                const double* ranNums = tile + j * lanes;
+                for(int s=0; s<streams; ++s){
+                    __m256d _c = _mm256_fmadd_pd(_a,_mm256_load_pd(ranNums + 4 * s),_partialCompVec);
+                    _prices[s] = _mm256_mul_pd(_prices[s],exp_full_approx(_c));
+                }
+            }
+        }
+        alignas(32) double finalPrices[lanes];
+        for(int s=0; s<streams; ++s){
+            _mm256_store_pd(finalPrices + 4 * s,_prices[s]);
+        }
+        for(int k=0; k<lanes && i+k<numPaths; ++k){
+            sumFinalPrices += finalPrices[k];
+        }
+    }
+    return numPaths > 0 ? sumFinalPrices / numPaths : 0.0;
+}
+
+std::pair<std::vector<std::vector<double>>,double> SimulateGBMStudentTMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int totalPaths,
+                                                                         int degreesOfFreedom, int numThreads)
+{
+    degreesOfFreedom = std::max(3, degreesOfFreedom);
+    double tScale = std::sqrt((degreesOfFreedom - 2.0) / degreesOfFreedom);
+    std::student_t_distribution<double> display(degreesOfFreedom);
+    return SimulateGBMKernelMT([degreesOfFreedom](int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT){
+        std::random_device rd;
+        StudentTShocks shocks((static_cast<uint64_t>(rd()) << 32) | rd(), degreesOfFreedom);
+        return CalculateSIMDPathsShocks(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, shocks);
+    }, startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths, numThreads, 0, nullptr,
+    [display, tScale](std::mt19937& gen) mutable { return display(gen) * tScale; });
+}
+
+std::pair<std::vector<std::vector<double>>,double> SimulateGBMNIGMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int totalPaths,
+                                                                    double alpha, double beta, double delta, int numThreads)
+{
+    if(!(alpha > std::abs(beta)) || !(delta > 0.0)){
+        throw std::invalid_argument("NIG parameters need alpha > |beta| and delta > 0");
+    }
+    NIGParameters parameters{alpha, beta, delta, 0.0};
+    //display paths reuse the SIMD shocks, one block per path is plenty
+    std::random_device rd;
+    auto displayShocks = std::make_shared<NIGShocks>((static_cast<uint64_t>(rd()) << 32) | rd(), parameters);
+    auto displayBuffer = std::make_shared<std::vector<double>>();
+    return SimulateGBMKernelMT([parameters](int numPaths, int steps, double startingPrice, double partialComputation, double normalizedStd, double sqrtDeltaT){
+        std::random_device rd;
+        NIGShocks shocks((static_cast<uint64_t>(rd()) << 32) | rd(), parameters);
+        return CalculateSIMDPathsShocks(numPaths, steps, startingPrice, partialComputation, normalizedStd, sqrtDeltaT, shocks);
+    }, startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, totalPaths, numThreads, 0, nullptr,
+    [displayShocks, displayBuffer](std::mt19937&){
+        if(displayBuffer->empty()){
+            alignas(32) double block[8];
+            displayShocks->Fill(block, 8);
+            displayBuffer->assign(block, block + 8);
+        }
+        double shock = displayBuffer->back();
+        displayBuffer->pop_back();
+        return shock;
+    });
+}
+
+struct StudentTFit{
+    int degreesOfFreedom;
+    double location;
+    double scale;
+    double logLikelihood;
+};
+
+//maximum likelihood over integer degrees of freedom 3..100 with location and scale pinned to the sample mean and
+//deviation (scale = deviation sqrt((dof - 2) / dof)); the likelihood is flat enough in dof that an integer grid is plenty
+StudentTFit FitStudentTData(const double* logReturns, size_t numReturns){
+    double sum = 0.0, sumSquares = 0.0;
+    size_t n = 0;
+    for(size_t i=0; i<numReturns; ++i){
+        if(std::isfinite(logReturns[i])){
+            sum += logReturns[i];
+            ++n;
+        }
+    }
+    if(n < 3){
+        throw std::invalid_argument("need at least three finite log returns");
+    }
+    double mean = sum / n;
+    for(size_t i=0; i<numReturns; ++i){
+        if(std::isfinite(logReturns[i])){
+            sumSquares += (logReturns[i] - mean) * (logReturns[i] - mean);
+        }
+    }
+    double deviation = std::sqrt(sumSquares / (n - 1));
+    StudentTFit best{100, mean, deviation, -std::numeric_limits<double>::infinity()};
+    for(int dof=3; dof<=100; ++dof){
+        double scale = deviation * std::sqrt((dof - 2.0) / dof);
+        double constant = std::lgamma(0.5 * (dof + 1)) - std::lgamma(0.5 * dof) - 0.5 * std::log(dof * M_PI) - std::log(scale);
+        double logLikelihood = n * constant;
+        for(size_t i=0; i<numReturns; ++i){
+            if(std::isfinite(logReturns[i])){
+                double x = (logReturns[i] - mean) / scale;
+                logLikelihood -= 0.5 * (dof + 1) * std::log1p(x * x / dof);
+            }
+        }
+        if(logLikelihood > best.logLikelihood){
+            best = StudentTFit{dof, mean, scale, logLikelihood};
+        }
+    }
+    return best;
+}
+
+//method of moments: with zeta = delta gamma and rho = beta / alpha, skew = 3 rho / sqrt(zeta) and excess kurtosis
+//= 3 (1 + 4 rho^2) / zeta, so zeta = 3 / (kurtosis - 4 skew^2 / 3); samples outside that region (too light tailed
+//for their skew) are clamped to the nearest admissible shape
+NIGParameters FitNIGData(const double* logReturns, size_t numReturns){
+    std::vector<double> values;
+    for(size_t i=0; i<numReturns; ++i){
+        if(std::isfinite(logReturns[i])){
+            values.push_back(logReturns[i]);
+        }
+    }
+    if(values.size() < 4){
+        throw std::invalid_argument("need at least four finite log returns");
+    }
+    double n = static_cast<double>(values.size());
+    double mean = 0.0;
+    for(double value : values){
+        mean += value;
+    }
+    mean /= n;
+    double m2 = 0.0, m3 = 0.0, m4 = 0.0;
+    for(double value : values){
+        double d = value - mean;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
+    }
+    m2 /= n;
+    m3 /= n;
+    m4 /= n;
+    double skew = m3 / std::pow(m2, 1.5);
+    double kurtosis = m4 / (m2 * m2) - 3.0;
+    //keep rho^2 = skew^2 zeta / 9 below 0.9 and zeta finite
+    kurtosis = std::max({kurtosis, 4.0 / 3.0 * skew * skew + 1e-3, 1e-3});
+    double zeta = 3.0 / (kurtosis - 4.0 / 3.0 * skew * skew);
+    double rho = skew * std::sqrt(zeta) / 3.0;
+    rho = std::max(-0.9, std::min(0.9, rho));
+    double alpha = std::sqrt(zeta / m2) / (1.0 - rho * rho);
+    double beta = rho * alpha;
+    double gamma = alpha * std::sqrt(1.0 - rho * rho);
+    double delta = zeta / gamma;
+    return NIGParameters{alpha, beta, delta, mean - delta * beta / gamma};
+}
+
+py::dict FitStudentT(py::array_t<double, py::array::c_style | py::array::forcecast> logReturns){
+    StudentTFit fit = FitStudentTData(logReturns.data(), static_cast<size_t>(logReturns.size()));
+    py::dict result;
+    result["degreesOfFreedom"] = fit.degreesOfFreedom;
+    result["location"] = fit.location;
+    result["scale"] = fit.scale;
+    result["logLikelihood"] = fit.logLikelihood;
+    return result;
+}
+
+py::dict FitNIG(py::array_t<double, py::array::c_style | py::array::forcecast> logReturns){
+    NIGParameters fit = FitNIGData(logReturns.data(), static_cast<size_t>(logReturns.size()));
+    py::dict result;
+    result["alpha"] = fit.alpha;
+    result["beta"] = fit.beta;
+    result["delta"] = fit.delta;
+    result["mu"] = fit.mu;
+    return result;
+}
+
+struct VarianceGammaParameters{
+    double sigma;
+    double theta;
+    double nu;
+};
+
+//log price increments of the Variance-Gamma process over one step dt, sampled exactly by subordination:
+//G ~ Gamma(dt / nu, nu) per lane and step, X = omega dt + theta G + sigma sqrt(G) z. A tile of gamma times and one of
+//normals are drawn per block, then the price update is pure arithmetic like the GBM block kernel
+double CalculateSIMDPathsVarianceGamma(int numPaths, int steps, double startingPrice, double deltaT, double omega, const VarianceGammaParameters& parameters, uint64_t seed)
+{
+    constexpr int lanes = 4;
+    int blockSteps = std::max(2, rngBlockSteps.load()) & ~1;
+    SIMDGammaGenerator gammas(seed, deltaT / parameters.nu);
+    SIMDNormalGenerator normals(SubstreamSeed(seed, 1));
+    std::vector<double> storage(2 * static_cast<size_t>(blockSteps) * lanes + 4);
+    double* gammaTile = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+    double* normalTile = gammaTile + static_cast<size_t>(blockSteps) * lanes;
+    __m256d _nu = _mm256_set1_pd(parameters.nu);
+    __m256d _theta = _mm256_set1_pd(parameters.theta);
+    __m256d _sigma = _mm256_set1_pd(parameters.sigma);
+    __m256d _drift = _mm256_set1_pd(omega * deltaT);
+    double sumFinalPrices = 0;
+    for(int i=0; i<numPaths; i+=lanes){
+        __m256d _prices = _mm256_set1_pd(startingPrice);
+        for(int blockStart=1; blockStart<steps; blockStart+=blockSteps){
+            int blockLength = std::min(blockSteps, steps - blockStart);
+            {
+                TraceScope trace("rngBlock");
+                gammas.Fill(gammaTile, static_cast<size_t>((blockLength + 1) & ~1) * lanes);
+                normals.Fill(normalTile, static_cast<size_t>((blockLength + 1) & ~1) * lanes);
+            }
+            TraceScope trace("priceUpdate");
+            for(int j=0; j<blockLength; ++j){
+                __m256d _g = _mm256_mul_pd(_mm256_load_pd(gammaTile + j * lanes),_nu);
+                __m256d _c = _mm256_fmadd_pd(_theta,_g,_drift);
+                _c = _mm256_fmadd_pd(_mm256_mul_pd(_sigma,_mm256_sqrt_pd(_g)),_mm256_load_pd(normalTile + j * lanes),_c);
+                _prices = _mm256_mul_pd(_prices,exp_full_approx(_c));
+            }
+        }
+        alignas(32) double finalPrices[lanes];
+        _mm256_store_pd(finalPrices,_prices);
+        for(int k=0; k<lanes && i+k<numPaths; ++k){
+            sumFinalPrices += finalPrices[k];
+        }
+    }
+    return numPaths > 0 ? sumFinalPrices / numPaths : 0.0;
+}
+
+//sigma, theta and nu are per unit horizon like normalizedMu; omega adds the convexity term
+//ln(1 - theta nu - sigma^2 nu / 2) / nu so the expected price still grows at normalizedMu
+std::pair<std::vector<std::vector<double>>,double> SimulateVarianceGammaMT(double startingPrice, double normalizedMu, double sigma, double theta, double nu, int steps, int totalPaths, int numThreads){
+    double compensator = 1.0 - theta * nu - 0.5 * sigma * sigma * nu;
+    if(!(nu > 0.0) || !(sigma >= 0.0) || !(compensator > 0.0)){
+        throw std::invalid_argument("Variance-Gamma needs nu > 0, sigma >= 0 and theta nu + sigma^2 nu / 2 < 1");
+    }
+    double deltaT = 1.0 / steps;
+    double omega = normalizedMu + std::log(compensator) / nu;
+    VarianceGammaParameters parameters{sigma, theta, nu};
+
+    std::vector<std::vector<double>> displayPaths;
+    int displayPathsCount = std::min(50, totalPaths);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<double> d(0.0,1.0);
+    std::gamma_distribution<double> g(deltaT / nu, nu);
+    for(int i=0; i<displayPathsCount; ++i){
+        std::vector<double> path(steps, startingPrice);
+        double price = startingPrice;
+        for(int j=1; j<steps; ++j){
+            double time = g(gen);
+            price *= std::exp(omega * deltaT + theta * time + sigma * std::sqrt(time) * d(gen));
+            path[j] = price;
+        }
+        displayPaths.push_back(std::move(path));
+    }
+
+    uint64_t seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    std::atomic<uint64_t> nextStream(0);
+    SIMDKernel kernel = [&](int numPaths, int steps, double startingPrice, double, double, double){
+        return CalculateSIMDPathsVarianceGamma(numPaths, steps, startingPrice, deltaT, omega, parameters, MixSeed(seed + nextStream++));
+    };
+    double averagePrice = RunSIMDKernelMT(kernel, totalPaths, steps, startingPrice, 0.0, 0.0, std::sqrt(deltaT), numThreads, 0);
+    return {displayPaths, averagePrice};
+}
+
+//Ornstein-Uhlenbeck dX = kappa (theta - X) dt + sigma dW stepped with its exact transition,
+//X' = theta + (X - theta) e^(-kappa dt) + sigma sqrt((1 - e^(-2 kappa dt)) / (2 kappa)) z, so any step size is valid
+struct OUStep{
+    double decay;
+    double shift;
+    double noise;
+};
+
+OUStep ExactOUStep(double kappa, double theta, double sigma, double deltaT){
+    double decay = std::exp(-kappa * deltaT);
+    //kappa -> 0 leaves a Brownian motion
+    double variance = kappa > 1e-12 ? (1.0 - decay * decay) / (2.0 * kappa) : deltaT;
+    return OUStep{decay, theta * (1.0 - decay), sigma * std::sqrt(variance)};
+}
+
+//same two phase layout as CalculateSIMDPathsBlockRNG, the update is two FMAs per step; with exponential the
+//average is of exp(X_T), one exp per path since the recurrence itself stays in log space
+double CalculateSIMDPathsOU(int numPaths, int steps, double startingValue, const OUStep& step, bool exponential)
+{
+    constexpr int streams = 4;
+    constexpr int lanes = 4 * streams;
+    int blockSteps = std::max(1, rngBlockSteps.load());
+    __m256d _decay = _mm256_set1_pd(step.decay);
+    __m256d _shift = _mm256_set1_pd(step.shift);
+    __m256d _noise = _mm256_set1_pd(step.noise);
+    std::random_device rd;
+    SIMDNormalGenerator generator((static_cast<uint64_t>(rd()) << 32) | rd());
+    std::vector<double> storage(static_cast<size_t>(blockSteps) * lanes + 4);
+    double* tile = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+    double startingState = exponential ? std::log(startingValue) : startingValue;
+    double sumFinalValues = 0;
+
+    for(int i=0; i<numPaths; i+=lanes){
+        __m256d _states[streams];
+        for(int s=0; s<streams; ++s){
+            _states[s] = _mm256_set1_pd(startingState);
+        }
+        for(int blockStart=1; blockStart<steps; blockStart+=blockSteps){
+            int blockLength = std::min(blockSteps, steps - blockStart);
+            {
+                TraceScope trace("rngBlock");
+                generator.Fill(tile, static_cast<size_t>(blockLength) * lanes);
+            }
+            TraceScope trace("priceUpdate");
+            for(int j=0; j<blockLength; ++j){
+                const double* ranNums = tile + j * lanes;
+                for(int s=0; s<streams; ++s){
+                    __m256d _mean = _mm256_fmadd_pd(_states[s],_decay,_shift);
+                    _states[s] = _mm256_fmadd_pd(_noise,_mm256_load_pd(ranNums + 4 * s),_mean);
+                }
+            }
+        }
+        alignas(32) double finalValues[lanes];
+        for(int s=0; s<streams; ++s){
+            _mm256_store_pd(finalValues + 4 * s,exponential ? exp_full_approx(_states[s]) : _states[s]);
+        }
+        for(int k=0; k<lanes && i+k<numPaths; ++k){
+            sumFinalValues += finalValues[k];
+        }
+    }
+    return numPaths > 0 ? sumFinalValues / numPaths : 0.0;
+}
+
+//kappa, theta and sigma are per unit horizon like normalizedMu (see CalibrateOU); exponential simulates the log
+//of a price as OU so theta is a log level and the paths are prices
+std::pair<std::vector<std::vector<double>>,double> SimulateOUMT(double startingValue, double kappa, double theta, double sigma, int steps, int totalPaths,
+                                                                bool exponential, int numThreads)
+{
+    if(exponential && !(startingValue > 0.0)){
+        throw std::invalid_argument("exponential OU needs a positive starting value");
+    }
+    OUStep step = ExactOUStep(kappa, theta, sigma, 1.0 / steps);
+
+    std::vector<std::vector<double>> displayPaths;
+    int displayPathsCount = std::min(50, totalPaths);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<double> d(0.0,1.0);
+    for(int i=0; i<displayPathsCount; ++i){
+        std::vector<double> path(steps, startingValue);
+        double state = exponential ? std::log(startingValue) : startingValue;
+        for(int j=1; j<steps; ++j){
+            state = step.shift + step.decay * state + step.noise * d(gen);
+            path[j] = exponential ? std::exp(state) : state;
+        }
+        displayPaths.push_back(std::move(path));
+    }
+
+    SIMDKernel kernel = [step, exponential](int numPaths, int steps, double startingValue, double, double, double){
+        return CalculateSIMDPathsOU(numPaths, steps, startingValue, step, exponential);
+    };
+    double average = RunSIMDKernelMT(kernel, totalPaths, steps, startingValue, 0.0, 0.0, 0.0, numThreads, 0);
+    return {displayPaths, average};
+}
+
+struct OUCalibration{
+    double kappa;
+    double theta;
+    double sigma;
+    double normalizedKappa;
+    double normalizedSigma;
+    double halfLife;
+    double observations;
+};
+
+//AR(1) least squares x_{t+1} = a + b x_t + e over the closes (or log closes) dated in [startDate, endDate), mapped
+//onto the exact OU transition with one observation as the time unit: kappa = -ln b, theta = a / (1 - b),
+//sigma = sd(e) sqrt(2 kappa / (1 - b^2)). The normalized values rescale to a horizon of steps observations the way
+//CalculateStatistics does for GBM
+OUCalibration CalibrateOUData(const int64_t* dates, const double* closes, int64_t rows, int64_t startDate, int64_t endDate, int steps, bool exponential){
+    std::vector<double> series;
+    for(int64_t i=0; i<rows; ++i){
+        if(dates[i] >= startDate && dates[i] < endDate && std::isfinite(closes[i]) && (!exponential || closes[i] > 0.0)){
+            series.push_back(exponential ? std::log(closes[i]) : closes[i]);
+        }
+    }
+    if(series.size() < 3){
+        throw std::invalid_argument("need at least three closes in the calibration window");
+    }
+    size_t n = series.size() - 1;
+    double meanX = 0.0, meanY = 0.0;
+    for(size_t i=0; i<n; ++i){
+        meanX += series[i];
+        meanY += series[i + 1];
+    }
+    meanX /= n;
+    meanY /= n;
+    double sxx = 0.0, sxy = 0.0;
+    for(size_t i=0; i<n; ++i){
+        sxx += (series[i] - meanX) * (series[i] - meanX);
+        sxy += (series[i] - meanX) * (series[i + 1] - meanY);
+    }
+    double b = sxy / sxx;
+    double a = meanY - b * meanX;
+    if(!(b > 0.0 && b < 1.0)){
+        throw std::runtime_error("series shows no mean reversion (AR(1) slope " + std::to_string(b) + ")");
+    }
+    double residualSquares = 0.0;
+    for(size_t i=0; i<n; ++i){
+        double residual = series[i + 1] - a - b * series[i];
+        residualSquares += residual * residual;
+    }
+    double residualDeviation = std::sqrt(residualSquares / std::max<size_t>(n - 2, 1));
+    OUCalibration calibration;
+    calibration.kappa = -std::log(b);
+    calibration.theta = a / (1.0 - b);
+    calibration.sigma = residualDeviation * std::sqrt(2.0 * calibration.kappa / (1.0 - b * b));
+    calibration.normalizedKappa = calibration.kappa * steps;
+    calibration.normalizedSigma = calibration.sigma * std::sqrt(static_cast<double>(steps));
+    calibration.halfLife = std::log(2.0) / calibration.kappa;
+    calibration.observations = static_cast<double>(series.size());
+    return calibration;
+}
+
+py::dict CalibrateOU(const std::string& filePath, int64_t startDate, int64_t endDate, int steps, bool exponential){
+    std::shared_ptr<PriceHistory> history = LoadCachedPriceHistory(filePath);
+    OUCalibration calibration = CalibrateOUData(history->dates, history->closes, history->rows, startDate, endDate, steps, exponential);
+    py::dict result;
+    result["kappa"] = calibration.kappa;
+    result["theta"] = calibration.theta;
+    result["sigma"] = calibration.sigma;
+    result["normalizedKappa"] = calibration.normalizedKappa;
+    result["normalizedSigma"] = calibration.normalizedSigma;
+    result["halfLife"] = calibration.halfLife;
+    result["observations"] = calibration.observations;
+    return result;
+}
+
+enum class RateModel{ vasicek, cir };
+
+struct StochasticRateResult{
+    std::vector<std::vector<double>> displayPaths;
+    double averagePrice;
+    double bondPrice;
+    double discountedPrice;
+    double callPrice;
+    double putPrice;
+    double averageTerminalRate;
+};
+
+//GBM whose drift is a stochastic short rate plus a constant premium. The rate is Vasicek (Gaussian OU with a constant
+//theta, exact step; Hull-White would add a theta(t) fitted to an initial curve) or CIR sampled exactly as
+//c ((z + sqrt(lambda))^2 + chi2(d - 1)), the non-central chi-square split that keeps the gamma shape (d - 1) / 2 fixed
+//so it vectorises; that needs d = 4 kappa theta / sigma^2 > 1. The asset shock is correlated with the rate's normal z.
+//Log price and log discount factor are both sums of the trapezoid rate integral, so each lane only needs one exp per
+//path at the end, and the discounted payoffs come out of the same pass
+StochasticRateResult SimulateGBMStochasticRatesData(double startingPrice, double normalizedVar, double normalizedStd, int steps, int totalPaths, RateModel model,
+                                                    double startingRate, double kappa, double theta, double rateSigma, double correlation, double premium,
+                                                    double strike, int numThreads)
+{
+    double deltaT = 1.0 / steps;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    OUStep ouStep = ExactOUStep(kappa, theta, rateSigma, deltaT);
+    //CIR transition constants: r' = scale chi2'(dof, r decay / scale)
+    double decay = std::exp(-kappa * deltaT);
+    double scale = rateSigma * rateSigma * (1.0 - decay) / (4.0 * kappa);
+    double dof = 4.0 * kappa * theta / (rateSigma * rateSigma);
+    if(model == RateModel::cir && !(dof > 1.0 && startingRate >= 0.0)){
+        throw std::invalid_argument("exact CIR sampling needs 4 kappa theta / sigma^2 > 1 and a non negative starting rate");
+    }
+    double orthogonal = std::sqrt(std::max(0.0, 1.0 - correlation * correlation));
+
+    struct Partial{
+        double sumPrices = 0.0, sumBonds = 0.0, sumDiscounted = 0.0, sumCalls = 0.0, sumPuts = 0.0, sumRates = 0.0;
+    };
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<Partial> partials(numThreads);
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    for(int t=0; t<numThreads; ++t){
+        int numPaths = pathsPerThread + (t < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, t, numPaths](){
+            TraceScope trace("worker");
+            constexpr int lanes = 4;
+            int blockSteps = std::max(2, rngBlockSteps.load()) & ~1;
+            std::random_device rd;
+            uint64_t seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+            SIMDNormalGenerator generator(seed);
+            SIMDGammaGenerator chiSquares(SubstreamSeed(seed, 1), model == RateModel::cir ? 0.5 * (dof - 1.0) : 1.0);
+            size_t tileSize = static_cast<size_t>(blockSteps) * lanes;
+            std::vector<double> storage(3 * tileSize + 4);
+            double* rateNormals = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+            double* assetNormals = rateNormals + tileSize;
+            double* gammas = assetNormals + tileSize;
+            __m256d _halfDT = _mm256_set1_pd(0.5 * deltaT);
+            __m256d _assetDrift = _mm256_set1_pd((premium - 0.5 * normalizedVar) * deltaT);
+            __m256d _assetScale = _mm256_set1_pd(normalizedStd * sqrtDeltaT);
+            __m256d _correlation = _mm256_set1_pd(correlation);
+            __m256d _orthogonal = _mm256_set1_pd(orthogonal);
+            __m256d _ouDecay = _mm256_set1_pd(ouStep.decay);
+            __m256d _ouShift = _mm256_set1_pd(ouStep.shift);
+            __m256d _ouNoise = _mm256_set1_pd(ouStep.noise);
+            __m256d _cirScale = _mm256_set1_pd(scale);
+            __m256d _cirLambda = _mm256_set1_pd(decay / scale);
+            __m256d _two = _mm256_set1_pd(2.0);
+            __m256d _strike = _mm256_set1_pd(strike);
+            Partial& partial = partials[t];
+            for(int i=0; i<numPaths; i+=lanes){
+                __m256d _rate = _mm256_set1_pd(startingRate);
+                __m256d _logPrice = _mm256_set1_pd(std::log(startingPrice));
+                //integral of the rate, the log discount factor is its negative
+                __m256d _rateIntegral = _mm256_setzero_pd();
+                for(int blockStart=1; blockStart<steps; blockStart+=blockSteps){
+                    int blockLength = std::min(blockSteps, steps - blockStart);
+                    size_t count = static_cast<size_t>((blockLength + 1) & ~1) * lanes;
+                    {
+                        TraceScope trace("rngBlock");
+                        generator.Fill(rateNormals, count);
+                        generator.Fill(assetNormals, count);
+                        if(model == RateModel::cir){
+                            chiSquares.Fill(gammas, count);
+                        }
+                    }
+                    TraceScope trace("priceUpdate");
+                    for(int j=0; j<blockLength; ++j){
+                        __m256d _z = _mm256_load_pd(rateNormals + j * lanes);
+                        __m256d _next;
+                        if(model == RateModel::cir){
+                            __m256d _root = _mm256_add_pd(_z,_mm256_sqrt_pd(_mm256_mul_pd(_rate,_cirLambda)));
+                            _next = _mm256_mul_pd(_cirScale,_mm256_fmadd_pd(_root,_root,_mm256_mul_pd(_two,_mm256_load_pd(gammas + j * lanes))));
+                        }else{
+                            _next = _mm256_fmadd_pd(_ouNoise,_z,_mm256_fmadd_pd(_rate,_ouDecay,_ouShift));
+                        }
+                        __m256d _stepIntegral = _mm256_mul_pd(_mm256_add_pd(_rate,_next),_halfDT);
+                        __m256d _w = _mm256_fmadd_pd(_correlation,_z,_mm256_mul_pd(_orthogonal,_mm256_load_pd(assetNormals + j * lanes)));
+                        _logPrice = _mm256_add_pd(_logPrice,_mm256_fmadd_pd(_assetScale,_w,_mm256_add_pd(_assetDrift,_stepIntegral)));
+                        _rateIntegral = _mm256_add_pd(_rateIntegral,_stepIntegral);
+                        _rate = _next;
+                    }
+                }
+                __m256d _price = exp_full_approx(_logPrice);
+                __m256d _discount = exp_full_approx(_mm256_sub_pd(_mm256_setzero_pd(),_rateIntegral));
+                __m256d _call = _mm256_mul_pd(_discount,_mm256_max_pd(_mm256_sub_pd(_price,_strike),_mm256_setzero_pd()));
+                __m256d _put = _mm256_mul_pd(_discount,_mm256_max_pd(_mm256_sub_pd(_strike,_price),_mm256_setzero_pd()));
+                alignas(32) double prices[4], discounts[4], calls[4], puts[4], rates[4];
+                _mm256_store_pd(prices,_price);
+                _mm256_store_pd(discounts,_discount);
+                _mm256_store_pd(calls,_call);
+                _mm256_store_pd(puts,_put);
+                _mm256_store_pd(rates,_rate);
+                for(int k=0; k<lanes && i+k<numPaths; ++k){
+                    partial.sumPrices += prices[k];
+                    partial.sumBonds += discounts[k];
+                    partial.sumDiscounted += discounts[k] * prices[k];
+                    partial.sumCalls += calls[k];
+                    partial.sumPuts += puts[k];
+                    partial.sumRates += rates[k];
+                }
+            }
+        });
+    }
+
+    //display paths from a scalar loop with the same transitions
+    StochasticRateResult result;
+    int displayPathsCount = std::min(50, totalPaths);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<double> d(0.0,1.0);
+    std::chi_squared_distribution<double> chiSquare(std::max(dof - 1.0, 1e-9));
+    for(int i=0; i<displayPathsCount; ++i){
+        std::vector<double> path(steps, startingPrice);
+        double rate = startingRate, logPrice = std::log(startingPrice);
+        for(int j=1; j<steps; ++j){
+            double z = d(gen);
+            double next = model == RateModel::cir ? scale * (std::pow(z + std::sqrt(rate * decay / scale), 2) + chiSquare(gen))
+                                                  : ouStep.shift + ouStep.decay * rate + ouStep.noise * z;
+            double w = correlation * z + orthogonal * d(gen);
+            logPrice += (premium - 0.5 * normalizedVar) * deltaT + 0.5 * (rate + next) * deltaT + normalizedStd * sqrtDeltaT * w;
+            rate = next;
+            path[j] = std::exp(logPrice);
+        }
+        result.displayPaths.push_back(std::move(path));
+    }
+
+    for(auto& thread : threads){
+        thread.join();
+    }
+    TraceScope trace("reduce");
+    Partial total;
+    for(const Partial& partial : partials){
+        total.sumPrices += partial.sumPrices;
+        total.sumBonds += partial.sumBonds;
+        total.sumDiscounted += partial.sumDiscounted;
+        total.sumCalls += partial.sumCalls;
+        total.sumPuts += partial.sumPuts;
+        total.sumRates += partial.sumRates;
+    }
+    double n = static_cast<double>(totalPaths);
+    result.averagePrice = total.sumPrices / n;
+    result.bondPrice = total.sumBonds / n;
+    result.discountedPrice = total.sumDiscounted / n;
+    result.callPrice = total.sumCalls / n;
+    result.putPrice = total.sumPuts / n;
+    result.averageTerminalRate = total.sumRates / n;
+    return result;
+}
+
+//rates and vols per unit horizon like normalizedMu; strike 0 means at the money
+py::dict SimulateGBMStochasticRatesMT(double startingPrice, double normalizedVar, double normalizedStd, int steps, int paths, std::string rateModel,
+                                      double startingRate, double kappa, double theta, double rateSigma, double correlation, double premium,
+                                      double strike, int numThreads)
+{
+    RateModel model;
+    if(rateModel == "cir"){
+        model = RateModel::cir;
+    }else if(rateModel == "vasicek"){
+        model = RateModel::vasicek;
+    }else{
+        throw std::invalid_argument("rateModel must be \"cir\" or \"vasicek\"");
+    }
+    if(paths <= 0 || steps < 2 || !(kappa > 0.0) || std::abs(correlation) > 1.0){
+        throw std::invalid_argument("need paths > 0, steps >= 2, kappa > 0 and |correlation| <= 1");
+    }
+    StochasticRateResult rates;
+    {
+        TracedGILRelease release;
+        rates = SimulateGBMStochasticRatesData(startingPrice, normalizedVar, normalizedStd, steps, paths, model, startingRate, kappa, theta, rateSigma,
+                                               correlation, premium, strike > 0.0 ? strike : startingPrice, numThreads);
+    }
+    py::dict result;
+    result["displayPaths"] = rates.displayPaths;
+    result["averagePrice"] = rates.averagePrice;
+    result["bondPrice"] = rates.bondPrice;
+    result["discountedPrice"] = rates.discountedPrice;
+    result["callPrice"] = rates.callPrice;
+    result["putPrice"] = rates.putPrice;
+    result["averageTerminalRate"] = rates.averageTerminalRate;
+    return result;
+}
+
+//a local vol surface resampled for the engine's grid: one row per step (time already interpolated) over uniformly spaced
+//log spot nodes, each node holding (vol, vol of next node - vol) next to each other so a lane fetches both with one
+//load. A lane's index is then a multiply and a floor, no search
+struct LocalVolTable{
+    int nodes = 0;
+    double logSpotStart = 0.0;
+    double inverseSpacing = 0.0;
+    std::vector<double> entries;
+
+    //vol at the given step for a log spot, flat beyond the grid
+    double Lookup(int step, double logSpot) const {
+        double position = std::min(std::max((logSpot - logSpotStart) * inverseSpacing, 0.0), nodes - 1.0);
+        int node = std::min(static_cast<int>(position), nodes - 2);
+        const double* entry = entries.data() + (static_cast<size_t>(step) * nodes + node) * 2;
+        return entry[0] + (position - node) * entry[1];
+    }
+};
+
+//linear interpolation in the given (increasing) abscissae, flat outside
+double InterpolateLinear(const double* xs, const double* ys, size_t count, size_t stride, double x){
+    if(x <= xs[0]){
+        return ys[0];
+    }
+    if(x >= xs[count - 1]){
+        return ys[(count - 1) * stride];
+    }
+    size_t upper = std::upper_bound(xs, xs + count, x) - xs;
+    double weight = (x - xs[upper - 1]) / (xs[upper] - xs[upper - 1]);
+    return ys[(upper - 1) * stride] + weight * (ys[upper * stride] - ys[(upper - 1) * stride]);
+}
+
+//vols is times x spots (row major), bilinear in time and spot on the given grid; step j of the engine uses the surface
+//at the start of the step, (j - 1) dt
+LocalVolTable BuildLocalVolTable(const double* times, size_t numTimes, const double* spots, size_t numSpots, const double* vols, int steps, int nodes){
+    LocalVolTable table;
+    table.nodes = std::max(nodes, 2);
+    table.logSpotStart = std::log(spots[0]);
+    double spacing = (std::log(spots[numSpots - 1]) - table.logSpotStart) / (table.nodes - 1);
+    table.inverseSpacing = spacing > 0.0 ? 1.0 / spacing : 0.0;
+    std::vector<double> timeRow(numSpots);
+    std::vector<double> nodeVols(table.nodes);
+    table.entries.assign(static_cast<size_t>(steps) * table.nodes * 2, 0.0);
+    for(int j=1; j<steps; ++j){
+        double time = (j - 1.0) / steps;
+        for(size_t k=0; k<numSpots; ++k){
+            timeRow[k] = InterpolateLinear(times, vols + k, numTimes, numSpots, time);
+        }
+        for(int m=0; m<table.nodes; ++m){
+            nodeVols[m] = InterpolateLinear(spots, timeRow.data(), numSpots, 1, std::exp(table.logSpotStart + m * spacing));
+        }
+        double* row = table.entries.data() + static_cast<size_t>(j) * table.nodes * 2;
+        for(int m=0; m<table.nodes; ++m){
+            row[2 * m] = nodeVols[m];
+            row[2 * m + 1] = m + 1 < table.nodes ? nodeVols[m + 1] - nodeVols[m] : 0.0;
+        }
+    }
+    return table;
+}
+
+//the block RNG recurrence in log space with vol(t, S) from the table: per step and lane an index from the log spot,
+//a gather of the node's (vol, slope) and an FMA for the vol, then the usual drift and shock; prices are exponentiated
+//once per path
+double CalculateSIMDPathsLocalVol(int numPaths, int steps, double startingPrice, double normalizedMu, const LocalVolTable& table)
+{
+    constexpr int streams = 4;
+    constexpr int lanes = 4 * streams;
+    int blockSteps = std::max(1, rngBlockSteps.load());
+    double deltaT = 1.0 / steps;
+    __m256d _muDT = _mm256_set1_pd(normalizedMu * deltaT);
+    __m256d _halfDT = _mm256_set1_pd(0.5 * deltaT);
+    __m256d _sqrtDT = _mm256_set1_pd(std::sqrt(deltaT));
+    __m256d _start = _mm256_set1_pd(table.logSpotStart);
+    __m256d _inverseSpacing = _mm256_set1_pd(table.inverseSpacing);
+    __m256d _lastPosition = _mm256_set1_pd(table.nodes - 1.0);
+    __m256d _lastNode = _mm256_set1_pd(table.nodes - 2.0);
+    std::random_device rd;
+    SIMDNormalGenerator generator((static_cast<uint64_t>(rd()) << 32) | rd());
+    std::vector<double> storage(static_cast<size_t>(blockSteps) * lanes + 4);
+    double* tile = reinterpret_cast<double*>((reinterpret_cast<uintptr_t>(storage.data()) + 31) & ~static_cast<uintptr_t>(31));
+    double sumFinalPrices = 0;
+
+    for(int i=0; i<numPaths; i+=lanes){
+        __m256d _logPrices[streams];
+        for(int s=0; s<streams; ++s){
+            _logPrices[s] = _mm256_set1_pd(std::log(startingPrice));
+        }
+        for(int blockStart=1; blockStart<steps; blockStart+=blockSteps){
+            int blockLength = std::min(blockSteps, steps - blockStart);
+            {
+                TraceScope trace("rngBlock");
+                generator.Fill(tile, static_cast<size_t>(blockLength) * lanes);
+            }
+            TraceScope trace("priceUpdate");
+            for(int j=0; j<blockLength; ++j){
+                const double* ranNums = tile + j * lanes;
+                const double* row = table.entries.data() + static_cast<size_t>(blockStart + j) * table.nodes * 2;
+                for(int s=0; s<streams; ++s){
+                    __m256d _position = _mm256_mul_pd(_mm256_sub_pd(_logPrices[s],_start),_inverseSpacing);
+                    _position = _mm256_min_pd(_mm256_max_pd(_position,_mm256_setzero_pd()),_lastPosition);
+                    __m256d _node = _mm256_min_pd(_mm256_floor_pd(_position),_lastNode);
+                    //each lane's (vol, slope) pair is one 16 byte load, two unpacks transpose them into vectors;
+                    //measured faster than a pair of _mm256_i64gather_pd on the same indices
+                    alignas(16) int32_t index[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(index),_mm256_cvtpd_epi32(_mm256_add_pd(_node,_node)));
+                    __m256d _low = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(row + index[0])),_mm_loadu_pd(row + index[2]),1);
+                    __m256d _high = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(row + index[1])),_mm_loadu_pd(row + index[3]),1);
+                    __m256d _vol = _mm256_unpacklo_pd(_low,_high);
+                    __m256d _slope = _mm256_unpackhi_pd(_low,_high);
+                    _vol = _mm256_fmadd_pd(_mm256_sub_pd(_position,_node),_slope,_vol);
+                    //(mu - vol^2 / 2) dt + vol sqrt(dt) z
+                    __m256d _c = _mm256_fnmadd_pd(_mm256_mul_pd(_vol,_vol),_halfDT,_muDT);
+                    _c = _mm256_fmadd_pd(_mm256_mul_pd(_vol,_sqrtDT),_mm256_load_pd(ranNums + 4 * s),_c);
+                    _logPrices[s] = _mm256_add_pd(_logPrices[s],_c);
+                }
+            }
+        }
+        alignas(32) double finalPrices[lanes];
+        for(int s=0; s<streams; ++s){
+            _mm256_store_pd(finalPrices + 4 * s,exp_full_approx(_logPrices[s]));
+        }
+        for(int k=0; k<lanes && i+k<numPaths; ++k){
+            sumFinalPrices += finalPrices[k];
+        }
+    }
+    return numPaths > 0 ? sumFinalPrices / numPaths : 0.0;
+}
+
+//times in units of the horizon (0 to 1), spots in price, vols per unit horizon like normalizedStd
+std::pair<std::vector<std::vector<double>>,double> SimulateLocalVolMTData(double startingPrice, double normalizedMu, const double* times, size_t numTimes,
+                                                                          const double* spots, size_t numSpots, const double* vols, int steps, int totalPaths,
+                                                                          int nodes, int numThreads)
+{
+    auto table = std::make_shared<LocalVolTable>(BuildLocalVolTable(times, numTimes, spots, numSpots, vols, steps, nodes));
+    double deltaT = 1.0 / steps;
+
+    std::vector<std::vector<double>> displayPaths;
+    int displayPathsCount = std::min(50, totalPaths);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::normal_distribution<double> d(0.0,1.0);
+    for(int i=0; i<displayPathsCount; ++i){
+        std::vector<double> path(steps, startingPrice);
+        double logPrice = std::log(startingPrice);
+        for(int j=1; j<steps; ++j){
+            double vol = table->Lookup(j, logPrice);
+            logPrice += (normalizedMu - 0.5 * vol * vol) * deltaT + vol * std::sqrt(deltaT) * d(gen);
+            path[j] = std::exp(logPrice);
+        }
+        displayPaths.push_back(std::move(path));
+    }
+
+    SIMDKernel kernel = [table, normalizedMu](int numPaths, int steps, double startingPrice, double, double, double){
+        return CalculateSIMDPathsLocalVol(numPaths, steps, startingPrice, normalizedMu, *table);
+    };
+    double average = RunSIMDKernelMT(kernel, totalPaths, steps, startingPrice, 0.0, 0.0, 0.0, numThreads, 0);
+    return {displayPaths, average};
+}
+
+py::tuple SimulateLocalVolMT(double startingPrice, double normalizedMu, py::array_t<double, py::array::c_style | py::array::forcecast> times,
+                             py::array_t<double, py::array::c_style | py::array::forcecast> spots,
+                             py::array_t<double, py::array::c_style | py::array::forcecast> vols, int steps, int paths, int nodes, int numThreads)
+{
+    if(vols.ndim() != 2 || vols.shape(0) != times.size() || vols.shape(1) != spots.size()){
+        throw std::invalid_argument("vols must be a (times x spots) array");
+    }
+    if(times.size() < 1 || spots.size() < 2 || !(spots.data()[0] > 0.0)){
+        throw std::invalid_argument("need at least one time and two positive spots");
+    }
+    for(py::ssize_t k=1; k<spots.size(); ++k){
+        if(!(spots.data()[k] > spots.data()[k - 1])){
+            throw std::invalid_argument("spots must be increasing");
+        }
+    }
+    for(py::ssize_t k=1; k<times.size(); ++k){
+        if(!(times.data()[k] > times.data()[k - 1])){
+            throw std::invalid_argument("times must be increasing");
+        }
+    }
+    std::pair<std::vector<std::vector<double>>,double> result;
+    {
+        TracedGILRelease release;
+        result = SimulateLocalVolMTData(startingPrice, normalizedMu, times.data(), static_cast<size_t>(times.size()), spots.data(), static_cast<size_t>(spots.size()),
+                                        vols.data(), steps, paths, nodes, numThreads);
+    }
+    return py::make_tuple(result.first, result.second);
+}
+
+//in place iterative radix-2 FFT, X_u = sum_j x_j e^(-2 pi i j u / N), size a power of two
+void FFTRadix2(std::vector<std::complex<double>>& data){
+    size_t n = data.size();
+    for(size_t i=1, j=0; i<n; ++i){
+        size_t bit = n >> 1;
+        for(; j & bit; bit >>= 1){
+            j ^= bit;
+        }
+        j ^= bit;
+        if(i < j){
+            std::swap(data[i], data[j]);
+        }
+    }
+    for(size_t length=2; length<=n; length<<=1){
+        double angle = -2.0 * M_PI / length;
+        std::complex<double> root(std::cos(angle), std::sin(angle));
+        for(size_t start=0; start<n; start+=length){
+            std::complex<double> twiddle(1.0, 0.0);
+            for(size_t k=0; k<length/2; ++k){
+                std::complex<double> even = data[start + k];
+                std::complex<double> odd = data[start + k + length / 2] * twiddle;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                twiddle *= root;
+            }
+        }
+    }
+}
+
+enum class PricingModel{ gbm, heston, varianceGamma };
+
+//model parameters in the order the bindings document: gbm (sigma), heston (v0, kappa, theta, sigmaV, rho),
+//varianceGamma (sigma, theta, nu)
+PricingModel ParsePricingModel(const std::string& model, const std::vector<double>& parameters){
+    if(model == "gbm" && parameters.size() == 1){
+        return PricingModel::gbm;
+    }
+    if(model == "heston" && parameters.size() == 5){
+        return PricingModel::heston;
+    }
+    if(model == "varianceGamma" && parameters.size() == 3){
+        return PricingModel::varianceGamma;
+    }
+    throw std::invalid_argument("model must be gbm (sigma), heston (v0, kappa, theta, sigmaV, rho) or varianceGamma (sigma, theta, nu)");
+}
+
+//E[exp(i u ln S_T)] under the risk neutral measure, u may be complex; Heston uses the "little trap" form that stays
+//on the right branch of the complex log for long maturities
+std::complex<double> CharacteristicFunction(PricingModel model, const std::vector<double>& parameters, double startingPrice, double rate, double maturity,
+                                            std::complex<double> u)
+{
+    const std::complex<double> i(0.0, 1.0);
+    std::complex<double> iu = i * u;
+    double logStart = std::log(startingPrice);
+    if(model == PricingModel::gbm){
+        double sigma = parameters[0];
+        return std::exp(iu * (logStart + (rate - 0.5 * sigma * sigma) * maturity) - 0.5 * sigma * sigma * maturity * u * u);
+    }
+    if(model == PricingModel::varianceGamma){
+        double sigma = parameters[0], theta = parameters[1], nu = parameters[2];
+        double omega = std::log(1.0 - theta * nu - 0.5 * sigma * sigma * nu) / nu;
+        return std::exp(iu * (logStart + (rate + omega) * maturity)) * std::pow(1.0 - iu * theta * nu + 0.5 * sigma * sigma * nu * u * u, -maturity / nu);
+    }
+    double v0 = parameters[0], kappa = parameters[1], theta = parameters[2], sigmaV = parameters[3], rho = parameters[4];
+    std::complex<double> beta = kappa - rho * sigmaV * iu;
+    std::complex<double> d = std::sqrt(beta * beta + sigmaV * sigmaV * (iu + u * u));
+    std::complex<double> g = (beta - d) / (beta + d);
+    std::complex<double> decay = std::exp(-d * maturity);
+    std::complex<double> c = iu * (logStart + rate * maturity)
+                           + kappa * theta / (sigmaV * sigmaV) * ((beta - d) * maturity - 2.0 * std::log((1.0 - g * decay) / (1.0 - g)));
+    std::complex<double> D = (beta - d) / (sigmaV * sigmaV) * (1.0 - decay) / (1.0 - g * decay);
+    return std::exp(c + D * v0);
+}
+
+struct StrikeGrid{
+    std::vector<double> logStrikes;
+    std::vector<double> callPrices;
+};
+
+//Carr-Madan: the damped call e^(alpha k) C(k) has the transform psi(v) = e^(-rT) phi(v - (alpha + 1) i) /
+//(alpha^2 + alpha - v^2 + i (2 alpha + 1) v), integrated with Simpson weights on v_j = eta j and evaluated by one FFT
+//at log strikes k_u = -b + lambda u with lambda eta = 2 pi / N, centred on ln S0
+StrikeGrid CarrMadanGrid(PricingModel model, const std::vector<double>& parameters, double startingPrice, double rate, double maturity,
+                         double alpha, int points, double eta)
+{
+    size_t n = static_cast<size_t>(points);
+    double lambda = 2.0 * M_PI / (n * eta);
+    double b = 0.5 * n * lambda;
+    double logStart = std::log(startingPrice);
+    const std::complex<double> i(0.0, 1.0);
+    std::vector<std::complex<double>> values(n);
+    for(size_t j=0; j<n; ++j){
+        double v = eta * j;
+        std::complex<double> denominator(alpha * alpha + alpha - v * v, (2.0 * alpha + 1.0) * v);
+        std::complex<double> psi = std::exp(-rate * maturity) * CharacteristicFunction(model, parameters, startingPrice, rate, maturity, v - (alpha + 1.0) * i) / denominator;
+        double simpson = (j == 0 ? 1.0 : (j % 2 == 1 ? 4.0 : 2.0)) / 3.0;
+        values[j] = std::exp(i * v * (b - logStart)) * psi * eta * simpson;
+    }
+    FFTRadix2(values);
+    StrikeGrid grid;
+    grid.logStrikes.resize(n);
+    grid.callPrices.resize(n);
+    for(size_t u=0; u<n; ++u){
+        double k = logStart - b + lambda * u;
+        grid.logStrikes[u] = k;
+        grid.callPrices[u] = std::exp(-alpha * k) / M_PI * values[u].real();
+    }
+    return grid;
+}
+
+//call prices at the requested strikes, linear in log strike between grid points
+std::vector<double> CarrMadanCallPrices(PricingModel model, const std::vector<double>& parameters, double startingPrice, double rate, double maturity,
+                                        const std::vector<double>& strikes, double alpha, int points, double eta)
+{
+    StrikeGrid grid = CarrMadanGrid(model, parameters, startingPrice, rate, maturity, alpha, points, eta);
+    std::vector<double> prices;
+    for(double strike : strikes){
+        prices.push_back(InterpolateLinear(grid.logStrikes.data(), grid.callPrices.data(), grid.logStrikes.size(), 1, std::log(strike)));
+    }
+    return prices;
+}
+
+py::dict CarrMadanPrices(std::string model, std::vector<double> parameters, double startingPrice, double rate, double maturity, std::vector<double> strikes,
+                         double alpha, int points, double eta)
+{
+    if(points < 2 || (points & (points - 1)) != 0){
+        throw std::invalid_argument("points must be a power of two");
+    }
+    PricingModel pricingModel = ParsePricingModel(model, parameters);
+    std::vector<double> calls = CarrMadanCallPrices(pricingModel, parameters, startingPrice, rate, maturity, strikes, alpha, points, eta);
+    std::vector<double> puts;
+    for(size_t k=0; k<strikes.size(); ++k){
+        puts.push_back(calls[k] - startingPrice + strikes[k] * std::exp(-rate * maturity));
+    }
+    py::dict result;
+    result["strikes"] = strikes;
+    result["callPrices"] = calls;
+    result["putPrices"] = puts;
+    return result;
+}
+
+struct MonteCarloPrices{
+    std::vector<double> callPrices;
+    std::vector<double> standardErrors;
+};
+
+//reference Monte Carlo for the cross-check: the same three models on four lanes (GBM exact in log space, VG by gamma
+//subordination, Heston by full truncation Euler), each group's terminal prices priced against every strike
+MonteCarloPrices MonteCarloCallPricesData(PricingModel model, const std::vector<double>& parameters, double startingPrice, double rate, double maturity,
+                                          const std::vector<double>& strikes, int steps, int totalPaths, int numThreads)
+{
+    double deltaT = maturity / steps;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    size_t numStrikes = strikes.size();
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<std::vector<double>> sums(numThreads, std::vector<double>(numStrikes, 0.0)), squares = sums;
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    for(int t=0; t<numThreads; ++t){
+        int numPaths = pathsPerThread + (t < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, t, numPaths](){
+            TraceScope trace("worker");
+            std::random_device rd;
+            uint64_t seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+            SIMDNormalGenerator generator(seed);
+            double gammaShape = model == PricingModel::varianceGamma ? deltaT / parameters[2] : 1.0;
+            SIMDGammaGenerator gammas(SubstreamSeed(seed, 1), gammaShape);
+            alignas(32) double normals[8], times[8];
+            for(int i=0; i<numPaths; i+=4){
+                __m256d _logPrice = _mm256_set1_pd(std::log(startingPrice));
+                __m256d _variance = _mm256_set1_pd(model == PricingModel::heston ? parameters[0] : 0.0);
+                for(int j=0; j<steps; ++j){
+                    generator.Fill(normals, 8);
+                    __m256d _z1 = _mm256_load_pd(normals);
+                    if(model == PricingModel::gbm){
+                        double sigma = parameters[0];
+                        _logPrice = _mm256_add_pd(_logPrice,_mm256_fmadd_pd(_mm256_set1_pd(sigma * sqrtDeltaT),_z1,_mm256_set1_pd((rate - 0.5 * sigma * sigma) * deltaT)));
+                    }else if(model == PricingModel::varianceGamma){
+                        double sigma = parameters[0], theta = parameters[1], nu = parameters[2];
+                        double omega = std::log(1.0 - theta * nu - 0.5 * sigma * sigma * nu) / nu;
+                        if((j & 1) == 0){
+                            gammas.Fill(times, 8);
+                        }
+                        __m256d _g = _mm256_mul_pd(_mm256_load_pd(times + 4 * (j & 1)),_mm256_set1_pd(nu));
+                        __m256d _c = _mm256_fmadd_pd(_mm256_set1_pd(theta),_g,_mm256_set1_pd((rate + omega) * deltaT));
+                        _logPrice = _mm256_add_pd(_logPrice,_mm256_fmadd_pd(_mm256_mul_pd(_mm256_set1_pd(sigma),_mm256_sqrt_pd(_g)),_z1,_c));
+                    }else{
+                        double kappa = parameters[1], theta = parameters[2], sigmaV = parameters[3], rho = parameters[4];
+                        __m256d _z2 = _mm256_fmadd_pd(_mm256_set1_pd(rho),_z1,_mm256_mul_pd(_mm256_set1_pd(std::sqrt(1.0 - rho * rho)),_mm256_load_pd(normals + 4)));
+                        __m256d _positive = _mm256_max_pd(_variance,_mm256_setzero_pd());
+                        __m256d _root = _mm256_mul_pd(_mm256_sqrt_pd(_positive),_mm256_set1_pd(sqrtDeltaT));
+                        _logPrice = _mm256_add_pd(_logPrice,_mm256_fmadd_pd(_root,_z1,_mm256_fnmadd_pd(_positive,_mm256_set1_pd(0.5 * deltaT),_mm256_set1_pd(rate * deltaT))));
+                        __m256d _meanReversion = _mm256_mul_pd(_mm256_set1_pd(kappa * deltaT),_mm256_sub_pd(_mm256_set1_pd(theta),_positive));
+                        _variance = _mm256_add_pd(_variance,_mm256_fmadd_pd(_mm256_mul_pd(_mm256_set1_pd(sigmaV),_root),_z2,_meanReversion));
+                    }
+                }
+                alignas(32) double prices[4];
+                _mm256_store_pd(prices,exp_full_approx(_logPrice));
+                for(int k=0; k<4 && i+k<numPaths; ++k){
+                    for(size_t s=0; s<numStrikes; ++s){
+                        double payoff = std::max(prices[k] - strikes[s], 0.0);
+                        sums[t][s] += payoff;
+                        squares[t][s] += payoff * payoff;
+                    }
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    MonteCarloPrices result;
+    double discount = std::exp(-rate * maturity);
+    double n = static_cast<double>(totalPaths);
+    for(size_t s=0; s<numStrikes; ++s){
+        double sum = 0.0, sumSquares = 0.0;
+        for(int t=0; t<numThreads; ++t){
+            sum += sums[t][s];
+            sumSquares += squares[t][s];
+        }
+        double mean = sum / n;
+        result.callPrices.push_back(discount * mean);
+        result.standardErrors.push_back(discount * std::sqrt(std::max(0.0, sumSquares / n - mean * mean) / std::max(n - 1.0, 1.0)));
+    }
+    return result;
+}
+
+//FFT prices next to a Monte Carlo run of the same model, with z scores (fft - mc) / se so a discrepancy beyond a few
+//standard errors points at the engine, the characteristic function or the FFT grid
+py::dict CrossCheckCarrMadan(std::string model, std::vector<double> parameters, double startingPrice, double rate, double maturity, std::vector<double> strikes,
+                             int steps, int paths, int numThreads)
+{
+    if(steps < 1 || paths < 1){
+        throw std::invalid_argument("need at least one path and one step");
+    }
+    PricingModel pricingModel = ParsePricingModel(model, parameters);
+    std::vector<double> fft;
+    MonteCarloPrices monteCarlo;
+    {
+        TracedGILRelease release;
+        fft = CarrMadanCallPrices(pricingModel, parameters, startingPrice, rate, maturity, strikes, 1.5, 4096, 0.25);
+        monteCarlo = MonteCarloCallPricesData(pricingModel, parameters, startingPrice, rate, maturity, strikes, steps, paths, numThreads);
+    }
+    std::vector<double> zScores;
+    for(size_t s=0; s<strikes.size(); ++s){
+        zScores.push_back(monteCarlo.standardErrors[s] > 0.0 ? (fft[s] - monteCarlo.callPrices[s]) / monteCarlo.standardErrors[s] : 0.0);
+    }
+    py::dict result;
+    result["strikes"] = strikes;
+    result["fftPrices"] = fft;
+    result["monteCarloPrices"] = monteCarlo.callPrices;
+    result["standardErrors"] = monteCarlo.standardErrors;
+    result["zScores"] = zScores;
+    return result;
+}
+
+//LU factor of a constant coefficient tridiagonal system (sub diagonal lower, diagonal diag, super diagonal upper) of
+//size count; reversed eliminates from the last row so back substitution runs from the first row upwards, the order
+//Brennan-Schwartz needs when the exercise region sits at the low end of the grid
+struct TridiagonalFactor{
+    std::vector<double> upperPrime;
+    std::vector<double> inverse;
+    double lower = 0.0;
+    bool reversed = false;
+
+    TridiagonalFactor(double lowerCoefficient, double diag, double upperCoefficient, int count, bool reverse)
+        : upperPrime(count), inverse(count), lower(reverse ? upperCoefficient : lowerCoefficient), reversed(reverse)
+    {
+        double upper = reverse ? lowerCoefficient : upperCoefficient;
+        double denominator = diag;
+        for(int i=0; i<count; ++i){
+            if(i > 0){
+                denominator = diag - lower * upperPrime[i - 1];
+            }
+            inverse[i] = 1.0 / denominator;
+            upperPrime[i] = upper * inverse[i];
+        }
+    }
+
+    int Row(int i) const {
+        return reversed ? static_cast<int>(inverse.size()) - 1 - i : i;
+    }
+};
+
+//Thomas on four right hand sides at once, values holds the interior nodes interleaved by lane and is overwritten with
+//the solution; a non null obstacle (same layout) is applied during back substitution
+void SolveTridiagonal4(const TridiagonalFactor& factor, double* values, const double* obstacle){
+    int count = static_cast<int>(factor.inverse.size());
+    __m256d _lower = _mm256_set1_pd(factor.lower);
+    __m256d _previous = _mm256_setzero_pd();
+    for(int i=0; i<count; ++i){
+        double* row = values + 4 * factor.Row(i);
+        _previous = _mm256_mul_pd(_mm256_fnmadd_pd(_lower,_previous,_mm256_load_pd(row)),_mm256_set1_pd(factor.inverse[i]));
+        _mm256_store_pd(row,_previous);
+    }
+    __m256d _next = _mm256_setzero_pd();
+    for(int i=count-1; i>=0; --i){
+        double* row = values + 4 * factor.Row(i);
+        _next = _mm256_fnmadd_pd(_mm256_set1_pd(factor.upperPrime[i]),_next,_mm256_load_pd(row));
+        if(obstacle){
+            _next = _mm256_max_pd(_next,_mm256_load_pd(obstacle + 4 * factor.Row(i)));
+        }
+        _mm256_store_pd(row,_next);
+    }
+}
+
+void SolveTridiagonal(const TridiagonalFactor& factor, double* values){
+    int count = static_cast<int>(factor.inverse.size());
+    double previous = 0.0;
+    for(int i=0; i<count; ++i){
+        previous = (values[factor.Row(i)] - factor.lower * previous) * factor.inverse[i];
+        values[factor.Row(i)] = previous;
+    }
+    double next = 0.0;
+    for(int i=count-1; i>=0; --i){
+        next = values[factor.Row(i)] - factor.upperPrime[i] * next;
+        values[factor.Row(i)] = next;
+    }
+}
+
+enum class BarrierType{ none, upAndOut, downAndOut };
+
+struct FiniteDifferenceResult{
+    std::vector<double> prices;
+    std::vector<double> deltas;
+    std::vector<double> gammas;
+    std::vector<double> logSpots;
+    std::vector<double> density;
+};
+
+//Crank-Nicolson in x = ln S for V_tau = sigma^2/2 V_xx + (r - sigma^2/2) V_x - r V, four strikes per SIMD solve since
+//the grid and so the matrix are shared; the first step is two implicit Euler half steps (Rannacher) to damp the
+//payoff kink. American options take the max with intrinsic inside the Thomas sweep (Brennan-Schwartz), barriers put
+//a zero Dirichlet edge on the barrier. The density of ln S_T (surviving paths for a barrier) comes from the transposed
+//operator marched forward from a unit mass at S0
+FiniteDifferenceResult SolveCrankNicolsonData(double startingPrice, double rate, double sigma, double maturity, const std::vector<double>& strikes,
+                                              bool put, bool american, BarrierType barrierType, double barrier, int spotNodes, int timeSteps)
+{
+    TraceScope trace("crankNicolson");
+    double logStart = std::log(startingPrice);
+    double width = std::max(6.0 * sigma * std::sqrt(maturity), 0.5);
+    double lowerEdge = logStart - width;
+    double upperEdge = logStart + width;
+    double spacing = (upperEdge - lowerEdge) / (spotNodes - 1);
+    //keep S0 on a node so prices and greeks need no interpolation, and the barrier exactly on the edge
+    if(barrierType == BarrierType::none){
+        lowerEdge = logStart - std::round(width / spacing) * spacing;
+    }else{
+        double barrierLog = std::log(barrier);
+        double distance = std::fabs(logStart - barrierLog);
+        //a barrier beyond the natural width stretches the grid so the far side still spans width past S0
+        if(distance > width){
+            spacing = (distance + width) / (spotNodes - 1);
+        }
+        int inside = std::min(spotNodes - 2, std::max(2, static_cast<int>(std::round(distance / spacing))));
+        spacing = distance / inside;
+        lowerEdge = barrierType == BarrierType::downAndOut ? barrierLog : barrierLog - (spotNodes - 1) * spacing;
+    }
+    int startNode = static_cast<int>(std::lround((logStart - lowerEdge) / spacing));
+    if(startNode < 1 || startNode > spotNodes - 2){
+        throw std::invalid_argument("startingPrice does not fall inside the grid, use more spotNodes");
+    }
+    int interior = spotNodes - 2;
+    double deltaT = maturity / timeSteps;
+    double drift = rate - 0.5 * sigma * sigma;
+    double diffusion = 0.5 * sigma * sigma / (spacing * spacing);
+    double advection = 0.5 * drift / spacing;
+    double lowerCoefficient = diffusion - advection;
+    double diagCoefficient = -2.0 * diffusion - rate;
+    double upperCoefficient = diffusion + advection;
+
+    FiniteDifferenceResult result;
+    result.logSpots.resize(spotNodes);
+    std::vector<double> spots(spotNodes);
+    for(int i=0; i<spotNodes; ++i){
+        result.logSpots[i] = lowerEdge + i * spacing;
+        spots[i] = std::exp(result.logSpots[i]);
+    }
+
+    //I - dt/2 L serves both crank nicolson over dt and the implicit euler half steps of the start
+    TridiagonalFactor factor(-0.5 * deltaT * lowerCoefficient, 1.0 - 0.5 * deltaT * diagCoefficient, -0.5 * deltaT * upperCoefficient, interior, put);
+
+    size_t groups = (strikes.size() + 3) / 4;
+    std::vector<double> storage(static_cast<size_t>(spotNodes) * 12 + 4);
+    double* values = reinterpret_cast<double*>((uintptr_t(storage.data())+31)&~31);
+    double* intrinsic = values + 4 * spotNodes;
+    double* previous = intrinsic + 4 * spotNodes;
+    for(size_t group=0; group<groups; ++group){
+        alignas(32) double strike[4];
+        for(int lane=0; lane<4; ++lane){
+            size_t k = std::min(group * 4 + lane, strikes.size() - 1);
+            strike[lane] = strikes[k];
+        }
+        for(int i=0; i<spotNodes; ++i){
+            for(int lane=0; lane<4; ++lane){
+                intrinsic[4 * i + lane] = std::max(put ? strike[lane] - spots[i] : spots[i] - strike[lane], 0.0);
+                values[4 * i + lane] = intrinsic[4 * i + lane];
+            }
+        }
+        if(barrierType != BarrierType::none){
+            int edge = barrierType == BarrierType::downAndOut ? 0 : spotNodes - 1;
+            for(int lane=0; lane<4; ++lane){
+                values[4 * edge + lane] = 0.0;
+            }
+        }
+        //rannacher start: the first step is two implicit Euler half steps (explicit weight zero), then crank nicolson
+        int subSteps = timeSteps + 1;
+        for(int sub=0; sub<subSteps; ++sub){
+            double tau = sub < 2 ? 0.5 * (sub + 1) * deltaT : sub * deltaT;
+            double explicitWeight = sub < 2 ? 0.0 : 0.5 * deltaT;
+            alignas(32) double lowerEdgeValue[4], upperEdgeValue[4];
+            for(int lane=0; lane<4; ++lane){
+                double discountedStrike = strike[lane] * std::exp(-rate * tau);
+                lowerEdgeValue[lane] = put ? (american ? strike[lane] : discountedStrike) - spots[0] : 0.0;
+                upperEdgeValue[lane] = put ? 0.0 : spots[spotNodes - 1] - discountedStrike;
+                if(barrierType == BarrierType::downAndOut){
+                    lowerEdgeValue[lane] = 0.0;
+                }else if(barrierType == BarrierType::upAndOut){
+                    upperEdgeValue[lane] = 0.0;
+                }
+            }
+            std::memcpy(previous, values, sizeof(double) * 4 * spotNodes);
+            __m256d _lower = _mm256_set1_pd(explicitWeight * lowerCoefficient);
+            __m256d _diag = _mm256_set1_pd(1.0 + explicitWeight * diagCoefficient);
+            __m256d _upper = _mm256_set1_pd(explicitWeight * upperCoefficient);
+            //interior right hand sides land one row down so the solve works on a contiguous interior block
+            for(int i=1; i<=interior; ++i){
+                __m256d _rhs = _mm256_mul_pd(_diag,_mm256_load_pd(previous + 4 * i));
+                _rhs = _mm256_fmadd_pd(_lower,_mm256_load_pd(previous + 4 * (i - 1)),_rhs);
+                _rhs = _mm256_fmadd_pd(_upper,_mm256_load_pd(previous + 4 * (i + 1)),_rhs);
+                _mm256_store_pd(values + 4 * (i - 1),_rhs);
+            }
+            __m256d _first = _mm256_load_pd(values);
+            _mm256_store_pd(values,_mm256_fmadd_pd(_mm256_set1_pd(0.5 * deltaT * lowerCoefficient),_mm256_load_pd(lowerEdgeValue),_first));
+            __m256d _last = _mm256_load_pd(values + 4 * (interior - 1));
+            _mm256_store_pd(values + 4 * (interior - 1),_mm256_fmadd_pd(_mm256_set1_pd(0.5 * deltaT * upperCoefficient),_mm256_load_pd(upperEdgeValue),_last));
+            SolveTridiagonal4(factor, values, american ? intrinsic + 4 : nullptr);
+            std::memmove(values + 4, values, sizeof(double) * 4 * interior);
+            _mm256_store_pd(values,_mm256_load_pd(lowerEdgeValue));
+            _mm256_store_pd(values + 4 * (spotNodes - 1),_mm256_load_pd(upperEdgeValue));
+        }
+        for(size_t lane=0; lane<4 && group * 4 + lane < strikes.size(); ++lane){
+            double below = values[4 * (startNode - 1) + lane], at = values[4 * startNode + lane], above = values[4 * (startNode + 1) + lane];
+            double firstLog = (above - below) / (2.0 * spacing);
+            double secondLog = (above - 2.0 * at + below) / (spacing * spacing);
+            result.prices.push_back(at);
+            result.deltas.push_back(firstLog / startingPrice);
+            result.gammas.push_back((secondLog - firstLog) / (startingPrice * startingPrice));
+        }
+    }
+
+    //fokker-planck for ln S_T: the transpose of the pricing operator without discounting, zero (absorbing) edges
+    double densityLower = diffusion + advection, densityDiag = -2.0 * diffusion, densityUpper = diffusion - advection;
+    TridiagonalFactor densityFactor(-0.5 * deltaT * densityLower, 1.0 - 0.5 * deltaT * densityDiag, -0.5 * deltaT * densityUpper, interior, false);
+    std::vector<double> density(spotNodes, 0.0), rhs(interior);
+    density[startNode] = 1.0 / spacing;
+    for(int sub=0; sub<timeSteps+1; ++sub){
+        double explicitWeight = sub < 2 ? 0.0 : 0.5 * deltaT;
+        for(int i=1; i<=interior; ++i){
+            rhs[i - 1] = density[i] + explicitWeight * (densityLower * density[i - 1] + densityDiag * density[i] + densityUpper * density[i + 1]);
+        }
+        SolveTridiagonal(densityFactor, rhs.data());
+        std::copy(rhs.begin(), rhs.end(), density.begin() + 1);
+    }
+    result.density = density;
+    return result;
+}
+
+py::dict SolveCrankNicolson(double startingPrice, double rate, double sigma, double maturity, std::vector<double> strikes, std::string optionType,
+                            std::string exercise, std::string barrierType, double barrier, int spotNodes, int timeSteps)
+{
+    if(optionType != "call" && optionType != "put"){
+        throw std::invalid_argument("optionType must be call or put");
+    }
+    if(exercise != "european" && exercise != "american"){
+        throw std::invalid_argument("exercise must be european or american");
+    }
+    BarrierType barrierKind;
+    if(barrierType == "none"){
+        barrierKind = BarrierType::none;
+    }else if(barrierType == "upAndOut" && barrier > startingPrice){
+        barrierKind = BarrierType::upAndOut;
+    }else if(barrierType == "downAndOut" && barrier > 0.0 && barrier < startingPrice){
+        barrierKind = BarrierType::downAndOut;
+    }else{
+        throw std::invalid_argument("barrierType must be none, upAndOut (barrier above startingPrice) or downAndOut (barrier below startingPrice)");
+    }
+    if(strikes.empty() || sigma <= 0.0 || maturity <= 0.0 || spotNodes < 8 || timeSteps < 1){
+        throw std::invalid_argument("need strikes, sigma > 0, maturity > 0, spotNodes >= 8 and timeSteps >= 1");
+    }
+    FiniteDifferenceResult solution;
+    {
+        TracedGILRelease release;
+        solution = SolveCrankNicolsonData(startingPrice, rate, sigma, maturity, strikes, optionType == "put", exercise == "american",
+                                          barrierKind, barrier, spotNodes, timeSteps);
+    }
+    py::dict result;
+    result["strikes"] = strikes;
+    result["prices"] = solution.prices;
+    result["deltas"] = solution.deltas;
+    result["gammas"] = solution.gammas;
+    result["logSpots"] = solution.logSpots;
+    result["density"] = solution.density;
+    return result;
+}
+
+struct LatticeResult{
+    double price = 0.0;
+    double delta = 0.0;
+    double gamma = 0.0;
+};
+
+//backward induction on a recombining binomial (CRR) or trinomial (Hull, u = e^(sigma sqrt(2 dt))) tree over one
+//array: node i at step n depends on nodes i .. i + branches - 1 at step n + 1, so the update runs in place from the
+//bottom with unaligned SIMD loads. Node spots move to step n by one multiply by u, the early exercise max uses them
+//directly. The last step is Black-Scholes (smoothed lattice), which makes the error regular enough in 1/steps for
+//Richardson extrapolation
+LatticeResult PriceLatticeData(double startingPrice, double rate, double sigma, double maturity, double strike, bool put, bool american,
+                               bool trinomial, int steps)
+{
+    double deltaT = maturity / steps;
+    double discount = std::exp(-rate * deltaT);
+    double up, weights[3];
+    if(trinomial){
+        up = std::exp(sigma * std::sqrt(2.0 * deltaT));
+        double half = std::exp(sigma * std::sqrt(0.5 * deltaT));
+        double growth = std::exp(0.5 * rate * deltaT);
+        double upProbability = std::pow((growth - 1.0 / half) / (half - 1.0 / half), 2.0);
+        double downProbability = std::pow((half - growth) / (half - 1.0 / half), 2.0);
+        weights[0] = discount * downProbability;
+        weights[1] = discount * (1.0 - upProbability - downProbability);
+        weights[2] = discount * upProbability;
+    }else{
+        up = std::exp(sigma * std::sqrt(deltaT));
+        double upProbability = (std::exp(rate * deltaT) - 1.0 / up) / (up - 1.0 / up);
+        weights[0] = discount * (1.0 - upProbability);
+        weights[1] = discount * upProbability;
+        weights[2] = 0.0;
+    }
+    if(weights[0] < 0.0 || weights[1] < 0.0 || weights[2] < 0.0){
+        throw std::invalid_argument("lattice probabilities are negative, use more steps");
+    }
+    //nodes at step n: n + 1 (binomial) or 2n + 1 (trinomial), spot of node i is S0 u^(2i - n) resp. S0 u^(i - n)
+    auto nodesAt = [&](int n){ return trinomial ? 2 * n + 1 : n + 1; };
+    int last = steps - 1;
+    std::vector<double> values(nodesAt(last) + 4), spots(nodesAt(last) + 4);
+    for(int i=0; i<nodesAt(last); ++i){
+        spots[i] = startingPrice * std::pow(up, trinomial ? i - last : 2 * i - last);
+        double call = BlackScholesCall(spots[i], strike, rate, sigma, deltaT);
+        double smoothed = put ? call - spots[i] + strike * discount : call;
+        values[i] = american ? std::max(smoothed, put ? strike - spots[i] : spots[i] - strike) : smoothed;
+    }
+    double sign = put ? -1.0 : 1.0;
+    __m256d _w0 = _mm256_set1_pd(weights[0]), _w1 = _mm256_set1_pd(weights[1]), _w2 = _mm256_set1_pd(weights[2]);
+    __m256d _sign = _mm256_set1_pd(sign), _strike = _mm256_set1_pd(sign * strike), _up = _mm256_set1_pd(up);
+    double stepOne[3] = {0.0, 0.0, 0.0};
+    for(int n=last-1; n>=0; --n){
+        int count = nodesAt(n);
+        int i = 0;
+        for(; i+4<=count; i+=4){
+            __m256d _value = _mm256_mul_pd(_w0,_mm256_loadu_pd(values.data() + i));
+            _value = _mm256_fmadd_pd(_w1,_mm256_loadu_pd(values.data() + i + 1),_value);
+            if(trinomial){
+                _value = _mm256_fmadd_pd(_w2,_mm256_loadu_pd(values.data() + i + 2),_value);
+            }
+            //binomial node i at step n sits at u^(2i - n) = u^(2i - n - 1) * u, trinomial at u^(i - n) = u^(i - n - 1) * u
+            __m256d _spot = _mm256_mul_pd(_mm256_loadu_pd(spots.data() + i),_up);
+            _mm256_storeu_pd(spots.data() + i,_spot);
+            if(american){
+                _value = _mm256_max_pd(_value,_mm256_fmsub_pd(_sign,_spot,_strike));
+            }
+            _mm256_storeu_pd(values.data() + i,_value);
+        }
+        for(; i<count; ++i){
+            double value = weights[0] * values[i] + weights[1] * values[i + 1] + (trinomial ? weights[2] * values[i + 2] : 0.0);
+            spots[i] *= up;
+            values[i] = american ? std::max(value, sign * spots[i] - sign * strike) : value;
+        }
+        if(n == 1){
+            std::copy(values.begin(), values.begin() + count, stepOne);
+        }
+    }
+    LatticeResult result;
+    result.price = values[0];
+    if(steps >= 2){
+        //greeks from the step one nodes, spots S0 / u and S0 u (binomial) or S0 / u, S0, S0 u (trinomial)
+        double low = startingPrice / up, high = startingPrice * up;
+        double lowValue = stepOne[0], highValue = trinomial ? stepOne[2] : stepOne[1];
+        result.delta = (highValue - lowValue) / (high - low);
+        if(trinomial){
+            double lowerSlope = (stepOne[1] - stepOne[0]) / (startingPrice - low);
+            double upperSlope = (stepOne[2] - stepOne[1]) / (high - startingPrice);
+            result.gamma = (upperSlope - lowerSlope) / (0.5 * (high - low));
+        }
+    }
+    return result;
+}
+
+py::dict PriceLattice(double startingPrice, double rate, double sigma, double maturity, double strike, std::string optionType, std::string exercise,
+                      std::string lattice, int steps, bool richardson)
+{
+    if(optionType != "call" && optionType != "put"){
+        throw std::invalid_argument("optionType must be call or put");
+    }
+    if(exercise != "european" && exercise != "american"){
+        throw std::invalid_argument("exercise must be european or american");
+    }
+    if(lattice != "binomial" && lattice != "trinomial"){
+        throw std::invalid_argument("lattice must be binomial or trinomial");
+    }
+    if(sigma <= 0.0 || maturity <= 0.0 || steps < 4){
+        throw std::invalid_argument("need sigma > 0, maturity > 0 and steps >= 4");
+    }
+    bool put = optionType == "put", american = exercise == "american", trinomial = lattice == "trinomial";
+    LatticeResult fine, coarse;
+    {
+        TracedGILRelease release;
+        TraceScope trace("lattice");
+        fine = PriceLatticeData(startingPrice, rate, sigma, maturity, strike, put, american, trinomial, steps);
+        if(richardson){
+            coarse = PriceLatticeData(startingPrice, rate, sigma, maturity, strike, put, american, trinomial, steps / 2);
+        }
+    }
+    py::dict result;
+    //first order error in 1/steps: P = 2 P(N) - P(N / 2)
+    result["price"] = richardson ? 2.0 * fine.price - coarse.price : fine.price;
+    result["latticePrice"] = fine.price;
+    result["coarsePrice"] = richardson ? py::cast(coarse.price) : py::none();
+    result["delta"] = fine.delta;
+    result["gamma"] = trinomial ? py::cast(fine.gamma) : py::none();
+    return result;
+}
+
+struct LongPathResult{
+    std::vector<double> samples;
+    std::vector<int64_t> sampleSteps;
+    std::vector<double> finalPrices;
+};
+
+//inclusive prefix sum of the four lanes plus the carry in every lane, returns the new carry broadcast
+inline __m256d PrefixSum4(__m256d& x, __m256d _carry){
+    __m256d _zero = _mm256_setzero_pd();
+    x = _mm256_add_pd(x,_mm256_blend_pd(_mm256_permute4x64_pd(x,_MM_SHUFFLE(2,1,0,0)),_zero,0b0001));
+    x = _mm256_add_pd(x,_mm256_blend_pd(_mm256_permute4x64_pd(x,_MM_SHUFFLE(1,0,0,0)),_zero,0b0011));
+    x = _mm256_add_pd(x,_carry);
+    return _mm256_permute4x64_pd(x,_MM_SHUFFLE(3,3,3,3));
+}
+
+//a few very long paths, parallel in time: log prices are the running sum of iid increments, so each thread takes a
+//contiguous block of steps, pass one sums its block, a serial exclusive scan over the block totals gives every block
+//its starting log price and pass two rebuilds the block's running sum in SIMD, keeping only samplePoints evenly spaced
+//points. The normals come from Philox with the roles of CounterPaths swapped (counter = (path, 0, group of 8 steps))
+//so both passes regenerate the same increments without storing them and the path does not depend on the thread count
+LongPathResult SimulateLongPathsData(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int64_t steps, int paths,
+                                     int samplePoints, uint64_t seed, int numThreads)
+{
+    double deltaT = 1.0 / steps;
+    double partialComputation = (normalizedMu - 0.5 * normalizedVar) * deltaT;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    //a path of steps points has steps - 1 increments, as in SimulatedGBM
+    int64_t increments = steps - 1;
+    int64_t groups = (increments + 7) / 8;
+    numThreads = ResolveThreadCount(numThreads, groups);
+    __m256d _partialCompVec = _mm256_set1_pd(partialComputation);
+    __m256d _a = _mm256_set1_pd(normalizedStd * sqrtDeltaT);
+    LongPathResult result;
+    result.sampleSteps.resize(samplePoints);
+    for(int s=0; s<samplePoints; ++s){
+        result.sampleSteps[s] = samplePoints == 1 ? increments : static_cast<int64_t>((static_cast<long double>(s) * increments) / (samplePoints - 1));
+    }
+    result.samples.assign(static_cast<size_t>(paths) * samplePoints, 0.0);
+    result.finalPrices.resize(paths);
+
+    //increments of steps 8g+1 .. 8g+8, lanes past the last increment zeroed
+    auto groupIncrements = [&](uint64_t path, int64_t g, __m256d& low, __m256d& high){
+        __m256i _groups = _mm256_set_epi64x(4 * g + 3, 4 * g + 2, 4 * g + 1, 4 * g);
+        CounterNormals(_groups, path, seed, low, high);
+        low = _mm256_fmadd_pd(_a,low,_partialCompVec);
+        high = _mm256_fmadd_pd(_a,high,_partialCompVec);
+        if(g == groups - 1 && increments % 8 != 0){
+            __m256d _first = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+            __m256d _valid = _mm256_set1_pd(static_cast<double>(increments - 8 * g));
+            low = _mm256_and_pd(low,_mm256_cmp_pd(_first,_valid,_CMP_LT_OQ));
+            high = _mm256_and_pd(high,_mm256_cmp_pd(_mm256_add_pd(_first,_mm256_set1_pd(4.0)),_valid,_CMP_LT_OQ));
+        }
+    };
+
+    std::vector<double> blockTotals(numThreads), blockStarts(numThreads);
+    for(int path=0; path<paths; ++path){
+        double* pathSamples = result.samples.data() + static_cast<size_t>(path) * samplePoints;
+        std::vector<std::thread> threads;
+        for(int t=0; t<numThreads; ++t){
+            threads.emplace_back([&, t](){
+                TraceScope trace("reduce");
+                int64_t begin = groups * t / numThreads, end = groups * (t + 1) / numThreads;
+                __m256d _sum = _mm256_setzero_pd();
+                for(int64_t g=begin; g<end; ++g){
+                    __m256d _low, _high;
+                    groupIncrements(path, g, _low, _high);
+                    _sum = _mm256_add_pd(_sum,_mm256_add_pd(_low,_high));
+                }
+                alignas(32) double lanes[4];
+                _mm256_store_pd(lanes,_sum);
+                blockTotals[t] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            });
+        }
+        for(auto& thread : threads){
+            thread.join();
+        }
+        double running = 0.0;
+        for(int t=0; t<numThreads; ++t){
+            blockStarts[t] = running;
+            running += blockTotals[t];
+        }
+        threads.clear();
+        for(int t=0; t<numThreads; ++t){
+            threads.emplace_back([&, t](){
+                TraceScope trace("scan");
+                int64_t begin = groups * t / numThreads, end = groups * (t + 1) / numThreads;
+                //first sample whose point falls in this block (point p = log price after p increments)
+                int sample = static_cast<int>(std::lower_bound(result.sampleSteps.begin(), result.sampleSteps.end(), 8 * begin + 1) - result.sampleSteps.begin());
+                __m256d _carry = _mm256_set1_pd(blockStarts[t]);
+                alignas(32) double logs[8];
+                for(int64_t g=begin; g<end; ++g){
+                    __m256d _low, _high;
+                    groupIncrements(path, g, _low, _high);
+                    _carry = PrefixSum4(_low, _carry);
+                    _carry = PrefixSum4(_high, _carry);
+                    int64_t lastPoint = 8 * g + 8;
+                    if(sample < samplePoints && result.sampleSteps[sample] <= lastPoint){
+                        _mm256_store_pd(logs,_low);
+                        _mm256_store_pd(logs + 4,_high);
+                        for(; sample < samplePoints && result.sampleSteps[sample] <= lastPoint; ++sample){
+                            pathSamples[sample] = logs[result.sampleSteps[sample] - 8 * g - 1];
+                        }
+                    }
+                }
+            });
+        }
+        for(auto& thread : threads){
+            thread.join();
+        }
+        for(int s=0; s<samplePoints; ++s){
+            pathSamples[s] = startingPrice * std::exp(result.sampleSteps[s] == 0 ? 0.0 : pathSamples[s]);
+        }
+        result.finalPrices[path] = startingPrice * std::exp(running);
+    }
+    return result;
+}
+
+py::dict SimulateLongPathsMT(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int64_t steps, int paths,
+                             int samplePoints, uint64_t seed, int numThreads)
+{
+    if(steps < 2 || paths < 1 || samplePoints < 1){
+        throw std::invalid_argument("need steps >= 2, paths >= 1 and samplePoints >= 1");
+    }
+    seed = ResolveSeed(seed);
+    LongPathResult longPaths;
+    {
+        TracedGILRelease release;
+        longPaths = SimulateLongPathsData(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, paths, samplePoints, seed, numThreads);
+    }
+    double average = 0.0;
+    for(double price : longPaths.finalPrices){
+        average += price / paths;
+    }
+    py::dict result;
+    result["samples"] = VectorToArray(std::move(longPaths.samples), {paths, samplePoints});
+    result["sampleSteps"] = longPaths.sampleSteps;
+    result["finalPrices"] = longPaths.finalPrices;
+    result["average"] = average;
+    result["seed"] = seed;
+    return result;
+}
+
+//eigen decomposition of a small symmetric matrix (row major, size x size) by cyclic Jacobi rotations, eigenvalues
+//descending with the matching eigenvectors as columns of vectors
+void SymmetricEigen(std::vector<double> matrix, size_t size, std::vector<double>& values, std::vector<double>& vectors){
+    vectors.assign(size * size, 0.0);
+    for(size_t i=0; i<size; ++i){
+        vectors[i * size + i] = 1.0;
+    }
+    for(int sweep=0; sweep<100; ++sweep){
+        double offDiagonal = 0.0;
+        for(size_t p=0; p<size; ++p){
+            for(size_t q=p+1; q<size; ++q){
+                offDiagonal += matrix[p * size + q] * matrix[p * size + q];
+            }
+        }
+        if(offDiagonal < 1e-30){
+            break;
+        }
+        for(size_t p=0; p<size; ++p){
+            for(size_t q=p+1; q<size; ++q){
+                double apq = matrix[p * size + q];
+                if(std::fabs(apq) < 1e-300){
+                    continue;
+                }
+                double theta = (matrix[q * size + q] - matrix[p * size + p]) / (2.0 * apq);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0), sn = t * c;
+                for(size_t k=0; k<size; ++k){
+                    double akp = matrix[k * size + p], akq = matrix[k * size + q];
+                    matrix[k * size + p] = c * akp - sn * akq;
+                    matrix[k * size + q] = sn * akp + c * akq;
+                }
+                for(size_t k=0; k<size; ++k){
+                    double apk = matrix[p * size + k], aqk = matrix[q * size + k];
+                    matrix[p * size + k] = c * apk - sn * aqk;
+                    matrix[q * size + k] = sn * apk + c * aqk;
+                }
+                for(size_t k=0; k<size; ++k){
+                    double vkp = vectors[k * size + p], vkq = vectors[k * size + q];
+                    vectors[k * size + p] = c * vkp - sn * vkq;
+                    vectors[k * size + q] = sn * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    std::vector<size_t> order(size);
+    for(size_t i=0; i<size; ++i){
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return matrix[a * size + a] > matrix[b * size + b]; });
+    std::vector<double> sorted(size * size);
+    values.resize(size);
+    for(size_t j=0; j<size; ++j){
+        values[j] = matrix[order[j] * size + order[j]];
+        for(size_t i=0; i<size; ++i){
+            sorted[i * size + j] = vectors[i * size + order[j]];
+        }
+    }
+    vectors.swap(sorted);
+}
+
+struct FactorModel{
+    size_t numTickers = 0;
+    size_t numFactors = 0;
+    std::vector<double> loadings;
+    std::vector<double> idiosyncraticVariance;
+    std::vector<double> eigenvalues;
+    double explainedVariance = 0.0;
+};
+
+//truncated PCA of the return correlation matrix without ever forming it: returns are standardized per ticker
+//(missing entries imputed at the mean, i.e. zero), then subspace iteration multiplies a (tickers x (k + oversampling))
+//block by C = X'X / (T - 1) as X' (X Q), O(T n k) per iteration, with a Rayleigh-Ritz step on the small projected
+//matrix at the end. Loadings are the top k eigenvectors scaled by sqrt(eigenvalue), every ticker keeps unit variance
+//through its idiosyncratic part 1 - |loadings|^2
+FactorModel FitFactorModelData(const double* returns, size_t numDates, size_t numTickers, size_t numFactors, int iterations, int numThreads){
+    TraceScope trace("factorPCA");
+    size_t width = std::min(numTickers, numFactors + std::min<size_t>(10, numTickers - numFactors));
+    std::vector<double> standardized(numDates * numTickers, 0.0);
+    for(size_t i=0; i<numTickers; ++i){
+        double sum = 0.0, sumSquares = 0.0, count = 0.0;
+        for(size_t t=0; t<numDates; ++t){
+            double x = returns[t * numTickers + i];
+            if(std::isfinite(x)){
+                sum += x;
+                sumSquares += x * x;
+                count += 1.0;
+            }
+        }
+        double mean = count > 0.0 ? sum / count : 0.0;
+        double deviation = count > 1.0 ? std::sqrt(std::max(sumSquares - count * mean * mean, 0.0) / (count - 1.0)) : 0.0;
+        for(size_t t=0; t<numDates; ++t){
+            double x = returns[t * numTickers + i];
+            standardized[t * numTickers + i] = std::isfinite(x) && deviation > 0.0 ? (x - mean) / deviation : 0.0;
+        }
+    }
+
+    numThreads = ResolveThreadCount(numThreads, static_cast<long long>(numTickers));
+    std::vector<double> basis(numTickers * width), scores(numDates * width), product(numTickers * width);
+    //scores = X basis split by dates, product = X' scores / (T - 1) split by tickers
+    auto multiply = [&](){
+        std::vector<std::thread> threads;
+        for(int th=0; th<numThreads; ++th){
+            threads.emplace_back([&, th](){
+                size_t begin = numDates * th / numThreads, end = numDates * (th + 1) / numThreads;
+                for(size_t t=begin; t<end; ++t){
+                    double* row = scores.data() + t * width;
+                    std::fill(row, row + width, 0.0);
+                    for(size_t i=0; i<numTickers; ++i){
+                        double x = standardized[t * numTickers + i];
+                        for(size_t j=0; j<width; ++j){
+                            row[j] += x * basis[i * width + j];
+                        }
+                    }
+                }
+            });
+        }
+        for(auto& thread : threads){
+            thread.join();
+        }
+        threads.clear();
+        double scale = 1.0 / std::max<double>(numDates - 1.0, 1.0);
+        for(int th=0; th<numThreads; ++th){
+            threads.emplace_back([&, th](){
+                size_t begin = numTickers * th / numThreads, end = numTickers * (th + 1) / numThreads;
+                std::fill(product.begin() + begin * width, product.begin() + end * width, 0.0);
+                for(size_t t=0; t<numDates; ++t){
+                    const double* row = scores.data() + t * width;
+                    for(size_t i=begin; i<end; ++i){
+                        double x = standardized[t * numTickers + i] * scale;
+                        for(size_t j=0; j<width; ++j){
+                            product[i * width + j] += x * row[j];
+                        }
+                    }
+                }
+            });
+        }
+        for(auto& thread : threads){
+            thread.join();
+        }
+    };
+    //modified Gram-Schmidt on the columns of product into basis
+    auto orthonormalize = [&](){
+        basis = product;
+        for(size_t j=0; j<width; ++j){
+            for(size_t previous=0; previous<j; ++previous){
+                double dot = 0.0;
+                for(size_t i=0; i<numTickers; ++i){
+                    dot += basis[i * width + j] * basis[i * width + previous];
+                }
+                for(size_t i=0; i<numTickers; ++i){
+                    basis[i * width + j] -= dot * basis[i * width + previous];
+                }
+            }
+            double norm = 0.0;
+            for(size_t i=0; i<numTickers; ++i){
+                norm += basis[i * width + j] * basis[i * width + j];
+            }
+            norm = norm > 0.0 ? 1.0 / std::sqrt(norm) : 0.0;
+            for(size_t i=0; i<numTickers; ++i){
+                basis[i * width + j] *= norm;
+            }
+        }
+    };
+
+    std::mt19937_64 gen(0x9E3779B97F4A7C15ULL);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    for(double& value : product){
+        value = normal(gen);
+    }
+    orthonormalize();
+    for(int iteration=0; iteration<iterations; ++iteration){
+        multiply();
+        orthonormalize();
+    }
+    //rayleigh-ritz: basis' C basis, with C basis already in product after one more multiply
+    multiply();
+    std::vector<double> projected(width * width, 0.0);
+    for(size_t a=0; a<width; ++a){
+        for(size_t b=0; b<width; ++b){
+            double sum = 0.0;
+            for(size_t i=0; i<numTickers; ++i){
+                sum += basis[i * width + a] * product[i * width + b];
+            }
+            projected[a * width + b] = sum;
+        }
+    }
+    for(size_t a=0; a<width; ++a){
+        for(size_t b=a+1; b<width; ++b){
+            double mean = 0.5 * (projected[a * width + b] + projected[b * width + a]);
+            projected[a * width + b] = mean;
+            projected[b * width + a] = mean;
+        }
+    }
+    std::vector<double> values, vectors;
+    SymmetricEigen(projected, width, values, vectors);
+
+    FactorModel model;
+    model.numTickers = numTickers;
+    model.numFactors = numFactors;
+    model.loadings.assign(numTickers * numFactors, 0.0);
+    model.idiosyncraticVariance.resize(numTickers);
+    double totalVariance = 0.0;
+    for(size_t i=0; i<numTickers; ++i){
+        double sumSquares = 0.0;
+        for(size_t t=0; t<numDates; ++t){
+            sumSquares += standardized[t * numTickers + i] * standardized[t * numTickers + i];
+        }
+        totalVariance += sumSquares / std::max<double>(numDates - 1.0, 1.0);
+    }
+    for(size_t f=0; f<numFactors; ++f){
+        double eigenvalue = std::max(values[f], 0.0);
+        model.eigenvalues.push_back(eigenvalue);
+        model.explainedVariance += totalVariance > 0.0 ? eigenvalue / totalVariance : 0.0;
+        for(size_t i=0; i<numTickers; ++i){
+            double component = 0.0;
+            for(size_t j=0; j<width; ++j){
+                component += basis[i * width + j] * vectors[j * width + f];
+            }
+            model.loadings[i * numFactors + f] = component * std::sqrt(eigenvalue);
+        }
+    }
+    for(size_t i=0; i<numTickers; ++i){
+        double* row = model.loadings.data() + i * numFactors;
+        double common = 0.0;
+        for(size_t f=0; f<numFactors; ++f){
+            common += row[f] * row[f];
+        }
+        //imputed gaps can push a ticker's common variance past one, keep the model correlation valid
+        if(common > 1.0){
+            for(size_t f=0; f<numFactors; ++f){
+                row[f] /= std::sqrt(common);
+            }
+            common = 1.0;
+        }
+        model.idiosyncraticVariance[i] = 1.0 - common;
+    }
+    return model;
+}
+
+//correlated GBM for every ticker through the factor model, shock_i = sum_f L_if z_f + sqrt(psi_i) e_i, so a step
+//costs O(n k) instead of the O(n^2) of a full Cholesky factor. Loadings are transposed to factor major rows padded to
+//a multiple of four tickers, each step draws k + n normals as one tile and accumulates log prices four tickers per
+//register; paths are split across threads and only the per ticker sums of terminal prices are kept
+std::vector<double> SimulateFactorModelData(const double* startingPrices, const double* normalizedMu, const double* normalizedVar, const double* normalizedStd,
+                                            const FactorModel& model, int steps, int totalPaths, int numThreads)
+{
+    size_t numTickers = model.numTickers, numFactors = model.numFactors;
+    size_t padded = (numTickers + 3) / 4 * 4;
+    double deltaT = 1.0 / steps;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    //parameters padded with zero vol/drift, tickers without statistics simulate flat and report NaN
+    std::vector<double> storage(padded * (numFactors + 4) + 4, 0.0);
+    double* factorRows = reinterpret_cast<double*>((uintptr_t(storage.data())+31)&~31);
+    double* idiosyncratic = factorRows + padded * numFactors;
+    double* drifts = idiosyncratic + padded;
+    double* vols = drifts + padded;
+    for(size_t i=0; i<numTickers; ++i){
+        bool valid = startingPrices[i] > 0.0 && std::isfinite(normalizedStd[i]) && std::isfinite(normalizedMu[i]);
+        for(size_t f=0; f<numFactors; ++f){
+            factorRows[f * padded + i] = model.loadings[i * numFactors + f];
+        }
+        idiosyncratic[i] = std::sqrt(model.idiosyncraticVariance[i]);
+        drifts[i] = valid ? (normalizedMu[i] - 0.5 * normalizedVar[i]) * deltaT : 0.0;
+        vols[i] = valid ? normalizedStd[i] * sqrtDeltaT : 0.0;
+    }
+    size_t factorTile = (numFactors + 7) / 8 * 8;
+    size_t normalTile = factorTile + (padded + 7) / 8 * 8;
+    numThreads = ResolveThreadCount(numThreads, totalPaths);
+    std::vector<std::vector<double>> sums(numThreads, std::vector<double>(numTickers, 0.0));
+    std::vector<std::thread> threads;
+    int pathsPerThread = totalPaths / numThreads;
+    int remainingPaths = totalPaths % numThreads;
+    for(int t=0; t<numThreads; ++t){
+        int numPaths = pathsPerThread + (t < remainingPaths ? 1 : 0);
+        threads.emplace_back([&, t, numPaths](){
+            TraceScope trace("worker");
+            std::random_device rd;
+            SIMDNormalGenerator generator((static_cast<uint64_t>(rd()) << 32) | rd());
+            std::vector<double> buffer(normalTile + padded + 8);
+            double* normals = reinterpret_cast<double*>((uintptr_t(buffer.data())+31)&~31);
+            double* logs = normals + normalTile;
+            for(int p=0; p<numPaths; ++p){
+                std::fill(logs, logs + padded, 0.0);
+                for(int j=1; j<steps; ++j){
+                    generator.Fill(normals, normalTile);
+                    const double* idiosyncraticNormals = normals + factorTile;
+                    for(size_t i=0; i<padded; i+=4){
+                        __m256d _shock = _mm256_mul_pd(_mm256_load_pd(idiosyncratic + i),_mm256_load_pd(idiosyncraticNormals + i));
+                        for(size_t f=0; f<numFactors; ++f){
+                            _shock = _mm256_fmadd_pd(_mm256_load_pd(factorRows + f * padded + i),_mm256_set1_pd(normals[f]),_shock);
+                        }
+                        __m256d _step = _mm256_fmadd_pd(_mm256_load_pd(vols + i),_shock,_mm256_load_pd(drifts + i));
+                        _mm256_store_pd(logs + i,_mm256_add_pd(_mm256_load_pd(logs + i),_step));
+                    }
+                }
+                for(size_t i=0; i<numTickers; ++i){
+                    sums[t][i] += std::exp(logs[i]);
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    std::vector<double> averagePrices(numTickers, 0.0);
+    for(size_t i=0; i<numTickers; ++i){
+        bool valid = startingPrices[i] > 0.0 && std::isfinite(normalizedStd[i]) && std::isfinite(normalizedMu[i]);
+        for(int t=0; t<numThreads; ++t){
+            averagePrices[i] += sums[t][i];
+        }
+        averagePrices[i] = valid ? startingPrices[i] * averagePrices[i] / totalPaths : std::numeric_limits<double>::quiet_NaN();
+    }
+    return averagePrices;
+}
+
+py::dict FitFactorModel(py::array_t<double, py::array::c_style | py::array::forcecast> logReturns, int factors, int iterations, int numThreads){
+    if(logReturns.ndim() != 2){
+        throw std::invalid_argument("logReturns must be a (dates x tickers) array");
+    }
+    size_t numDates = static_cast<size_t>(logReturns.shape(0));
+    size_t numTickers = static_cast<size_t>(logReturns.shape(1));
+    if(factors < 1 || static_cast<size_t>(factors) > numTickers || numDates < 2){
+        throw std::invalid_argument("need 1 <= factors <= tickers and at least two dates");
+    }
+    FactorModel model;
+    {
+        TracedGILRelease release;
+        model = FitFactorModelData(logReturns.data(), numDates, numTickers, static_cast<size_t>(factors), iterations, numThreads);
+    }
+    py::ssize_t n = static_cast<py::ssize_t>(numTickers), k = factors;
+    py::dict result;
+    result["loadings"] = VectorToArray(std::move(model.loadings), {n, k});
+    result["idiosyncraticVariance"] = VectorToArray(std::move(model.idiosyncraticVariance), {n});
+    result["eigenvalues"] = model.eigenvalues;
+    result["explainedVariance"] = model.explainedVariance;
+    return result;
+}
+
+py::array_t<double> SimulateFactorModelMT(py::array_t<double, py::array::c_style | py::array::forcecast> startingPrices,
+                                          py::array_t<double, py::array::c_style | py::array::forcecast> normalizedMu,
+                                          py::array_t<double, py::array::c_style | py::array::forcecast> normalizedVar,
+                                          py::array_t<double, py::array::c_style | py::array::forcecast> normalizedStd,
+                                          py::array_t<double, py::array::c_style | py::array::forcecast> loadings,
+                                          py::array_t<double, py::array::c_style | py::array::forcecast> idiosyncraticVariance,
+                                          int steps, int paths, int numThreads)
+{
+    py::ssize_t n = startingPrices.size();
+    if(normalizedMu.size() != n || normalizedVar.size() != n || normalizedStd.size() != n || idiosyncraticVariance.size() != n){
+        throw std::invalid_argument("parameter arrays must all have one entry per ticker");
+    }
+    if(loadings.ndim() != 2 || loadings.shape(0) != n){
+        throw std::invalid_argument("loadings must be a (tickers x factors) array");
+    }
+    if(steps < 2 || paths < 1){
+        throw std::invalid_argument("need at least one path and two steps");
+    }
+    if(!std::all_of(loadings.data(), loadings.data() + loadings.size(), [](double x){ return std::isfinite(x); })
+       || !std::all_of(idiosyncraticVariance.data(), idiosyncraticVariance.data() + n, [](double x){ return std::isfinite(x); })){
+        throw std::invalid_argument("loadings and idiosyncraticVariance must be finite");
+    }
+    FactorModel model;
+    model.numTickers = static_cast<size_t>(n);
+    model.numFactors = static_cast<size_t>(loadings.shape(1));
+    model.loadings.assign(loadings.data(), loadings.data() + loadings.size());
+    model.idiosyncraticVariance.assign(idiosyncraticVariance.data(), idiosyncraticVariance.data() + n);
+    for(double& variance : model.idiosyncraticVariance){
+        variance = std::max(variance, 0.0);
+    }
+    std::vector<double> averagePrices;
+    {
+        TracedGILRelease release;
+        averagePrices = SimulateFactorModelData(startingPrices.data(), normalizedMu.data(), normalizedVar.data(), normalizedStd.data(),
+                                                model, steps, paths, numThreads);
+    }
+    return VectorToArray(std::move(averagePrices), {n});
+}
+
+//floating point work per path and step of the SIMD recurrence, counting an FMA as two:
+//fmadd (2) + exp_approx powers (4) + coefficient muls/adds (10) + price update (1)
+const double simdFlopsPerPathStep = 17.0;
+
+struct KernelTiming{
+    std::string name;
+    double seconds;
+    double cycles;
+    double pathStepsPerSecond;
+    double flopsPerCycle;
+    double averagePrice;
+};
+
+//single thread timing so the numbers reflect the kernel and not the scheduler, cycles are TSC reference cycles
+KernelTiming TimeKernel(const std::string& name, const std::function<double()>& run, int steps, int paths, int repeats){
+    KernelTiming timing{name, std::numeric_limits<double>::infinity(), 0.0, 0.0, 0.0, 0.0};
+    for(int r=0; r<repeats; ++r){
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long startCycles = __rdtsc();
+        double averagePrice = run();
+        unsigned long long endCycles = __rdtsc();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(seconds < timing.seconds){
+            timing.seconds = seconds;
+            timing.cycles = static_cast<double>(endCycles - startCycles);
+            timing.averagePrice = averagePrice;
+        }
+    }
+    double pathSteps = static_cast<double>(paths) * std::max(steps - 1, 0);
+    timing.pathStepsPerSecond = pathSteps / timing.seconds;
+    timing.flopsPerCycle = pathSteps * simdFlopsPerPathStep / timing.cycles;
+    return timing;
+}
+
+std::vector<KernelTiming> BenchmarkSIMDKernelsData(int steps, int paths, int repeats, const std::vector<int>& blockSizes){
+    double deltaT = 1.0 / steps;
+    double partialComputation = (0.05 - 0.5 * 0.04) * deltaT;
+    double normalizedStd = 0.2;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    std::vector<KernelTiming> timings;
+    for(int streams=1; streams<=4; ++streams){
+        SIMDKernel kernel = InterleavedKernel(streams);
+        std::string name = streams == 1 ? "CalculateSIMDPaths" : "Interleaved" + std::to_string(streams);
+        timings.push_back(TimeKernel(name, [=](){ return kernel(paths, steps, 100.0, partialComputation, normalizedStd, sqrtDeltaT); }, steps, paths, repeats));
+    }
+    for(int blockSteps : blockSizes){
+        timings.push_back(TimeKernel("BlockRNG" + std::to_string(blockSteps), [=](){
+            return CalculateSIMDPathsBlockRNG(paths, steps, 100.0, partialComputation, normalizedStd, sqrtDeltaT, blockSteps);
+        }, steps, paths, repeats));
+    }
+    return timings;
+}
+
+py::list BenchmarkSIMDKernels(int steps, int paths, int repeats, std::vector<int> blockSizes){
+    std::vector<KernelTiming> timings;
+    {
+        TracedGILRelease release;
+        timings = BenchmarkSIMDKernelsData(steps, paths, repeats, blockSizes);
+    }
+    py::list result;
+    for(const KernelTiming& timing : timings){
+        py::dict entry;
+        entry["kernel"] = timing.name;
+        entry["seconds"] = timing.seconds;
+        entry["cycles"] = timing.cycles;
+        entry["pathStepsPerSecond"] = timing.pathStepsPerSecond;
+        entry["flopsPerCycle"] = timing.flopsPerCycle;
+        entry["averagePrice"] = timing.averagePrice;
+        result.append(entry);
+    }
+    return result;
+}
+
+//benchmarks the engine on this machine in four stages (kernel on one thread, thread count, chunk size,
+//single thread cutoff for small runs), saves the winner to profilePath and makes it the active profile
+TuningProfile AutotuneData(const std::string& profilePath, int steps, int paths, std::vector<KernelTiming>& measurements){
+    double deltaT = 1.0 / steps;
+    double partialComputation = (0.05 - 0.5 * 0.04) * deltaT;
+    double normalizedStd = 0.2;
+    double sqrtDeltaT = std::sqrt(deltaT);
+    TuningProfile profile;
+    profile.cpuModel = CpuModelName();
+    profile.availableThreads = AvailableThreadCount();
+    auto rate = [&](const std::string& name, const SIMDKernel& kernel, int threads, int chunkPaths, int totalPaths){
+        KernelTiming timing = TimeKernel(name, [&](){
+            return RunSIMDKernelMT(kernel, totalPaths, steps, 100.0, partialComputation, normalizedStd, sqrtDeltaT, threads, chunkPaths);
+        }, steps, totalPaths, 2);
+        measurements.push_back(timing);
+        return timing.pathStepsPerSecond;
+    };
+
+    std::vector<std::pair<std::string, int>> kernels = {{"CalculateSIMDPaths", 0}, {"Interleaved2", 0}, {"Interleaved4", 0},
+                                                        {"BlockRNG", 32}, {"BlockRNG", 128}, {"BlockRNG", 512}};
+    if(HasAVX512()){
+        kernels.insert(kernels.end(), {{"BlockRNG512", 32}, {"BlockRNG512", 128}, {"BlockRNG512", 512}});
+    }
+    double best = 0.0;
+    for(const auto& candidate : kernels){
+        std::string name = candidate.first + (candidate.second > 0 ? ":" + std::to_string(candidate.second) : "");
+        double pathStepsPerSecond = rate(name, KernelByName(candidate.first, candidate.second), 1, 0, paths);
+        if(pathStepsPerSecond > best){
+            best = pathStepsPerSecond;
+            profile.kernel = candidate.first;
+            profile.blockSteps = candidate.second > 0 ? candidate.second : profile.blockSteps;
+        }
+    }
+    SIMDKernel kernel = KernelByName(profile.kernel, profile.blockSteps);
+
+    //every core vs every hardware thread, work grows with the thread count so each thread sees the same load
+    best = 0.0;
+    for(int threads : std::set<int>{PhysicalCoreCount(), AvailableThreadCount()}){
+        double pathStepsPerSecond = rate("threads" + std::to_string(threads), kernel, threads, 0, paths * threads);
+        if(pathStepsPerSecond > best){
+            best = pathStepsPerSecond;
+            profile.numThreads = threads;
+        }
+    }
+
+    best = 0.0;
+    for(int chunkPaths : {0, 4096, 65536}){
+        if(profile.numThreads == 1){
+            break;
+        }
+        double pathStepsPerSecond = rate("chunk" + std::to_string(chunkPaths), kernel, profile.numThreads, chunkPaths, paths * profile.numThreads);
+        if(pathStepsPerSecond > best){
+            best = pathStepsPerSecond;
+            profile.chunkPaths = chunkPaths;
+        }
+    }
+
+    //largest run for which one thread still beats spawning the pool
+    profile.singleThreadCutoff = 0;
+    if(profile.numThreads > 1){
+        for(int smallPaths : {16, 64, 256, 1024, 4096, 16384}){
+            double single = rate("single" + std::to_string(smallPaths), kernel, 1, 0, smallPaths);
+            double multi = rate("multi" + std::to_string(smallPaths), kernel, profile.numThreads, profile.chunkPaths, smallPaths);
+            if(multi > single){
+                break;
+            }
+            profile.singleThreadCutoff = static_cast<long long>(smallPaths) * steps + 1;
+        }
+    }
+
+    WriteTuningProfile(profilePath, profile);
+    SetActiveTuningProfile(profile);
+    return profile;
+}
+
+py::dict TuningProfileToDict(const TuningProfile& profile){
+    py::dict result;
+    result["cpuModel"] = profile.cpuModel;
+    result["availableThreads"] = profile.availableThreads;
+    result["kernel"] = profile.kernel;
+    result["blockSteps"] = profile.blockSteps;
+    result["numThreads"] = profile.numThreads;
+    result["chunkPaths"] = profile.chunkPaths;
+    result["singleThreadCutoff"] = profile.singleThreadCutoff;
+    return result;
+}
+
+py::dict Autotune(std::string profilePath, int steps, int paths){
+    if(profilePath.empty()){
+        profilePath = DefaultTuningProfilePath();
+    }
+    std::vector<KernelTiming> measurements;
+    TuningProfile profile;
+    {
+        TracedGILRelease release;
+        profile = AutotuneData(profilePath, steps, paths, measurements);
+    }
+    py::dict result = TuningProfileToDict(profile);
+    py::list timings;
+    for(const KernelTiming& timing : measurements){
+        py::dict entry;
+        entry["name"] = timing.name;
+        entry["seconds"] = timing.seconds;
+        entry["pathStepsPerSecond"] = timing.pathStepsPerSecond;
+        timings.append(entry);
+    }
+    result["measurements"] = timings;
+    result["profilePath"] = profilePath;
+    return result;
+}
+
+//None when no profile for this machine is loaded
+py::object GetTuningProfile(){
+    TuningProfile profile;
+    if(!ActiveTuningProfile(profile)){
+        return py::none();
+    }
+    return TuningProfileToDict(profile);
+}
+
+bool LoadTuningProfile(std::string profilePath){
+    TuningProfile profile;
+    if(!ReadTuningProfile(profilePath.empty() ? DefaultTuningProfilePath() : profilePath, profile)){
+        return false;
+    }
+    SetActiveTuningProfile(profile);
+    return true;
+}
+
+//raw totals plus IPC, cache miss rate and double precision FLOPs derived from the FP_ARITH counts
+py::dict PerfCountersToDict(const PerfCounterTotals& counters){
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    double values[PerfCounterTotals::numEvents];
+    py::dict result;
+    for(int e=0; e<PerfCounterTotals::numEvents; ++e){
+        values[e] = counters.opened[e] ? counters.values[e] : nan;
+        result[PerfCounterTotals::names[e]] = values[e];
+    }
+    result["workers"] = counters.workers;
+    result["available"] = counters.opened[0] || counters.opened[1];
+    result["ipc"] = values[1] / values[0];
+    result["cacheMissRate"] = values[3] / values[2];
+    result["doubleFlops"] = values[5] + 4.0 * values[6] + 8.0 * values[7];
+    return result;
+}
+
+//engines bound with a collectCounters flag: (paths, average) normally, (paths, average, counters) when set
+py::tuple SimulateGBMMultiThreadedBinding(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int paths,
+                                          int numThreads, bool collectCounters)
+{
+    PerfCounterTotals counters;
+    std::pair<std::vector<std::vector<double>>, double> result;
+    {
+        TracedGILRelease release;
+        result = SimulateGBMMultiThreaded(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, paths, numThreads, collectCounters ? &counters : nullptr);
+    }
+    if(!collectCounters){
+        return py::make_tuple(result.first, result.second);
+    }
+    return py::make_tuple(result.first, result.second, PerfCountersToDict(counters));
+}
+
+py::tuple SimulateGBMIntrinsicMTBinding(double startingPrice, double normalizedMu, double normalizedVar, double normalizedStd, int steps, int paths,
+                                        int numThreads, bool collectCounters)
+{
+    PerfCounterTotals counters;
+    std::pair<std::vector<std::vector<double>>, double> result;
+    {
+        TracedGILRelease release;
+        result = SimulateGBMIntrinsicMT(startingPrice, normalizedMu, normalizedVar, normalizedStd, steps, paths, numThreads, collectCounters ? &counters : nullptr);
+    }
+    if(!collectCounters){
+        return py::make_tuple(result.first, result.second);
+    }
+    return py::make_tuple(result.first, result.second, PerfCountersToDict(counters));
+}
+
+PYBIND11_MODULE(simulation, m) {
+    m.doc() = "Simulation module for performing GBM simulations and calculating statistics"; // Module docstring
+    m.def("add", &add, "A function which adds two numbers");
+    m.def("SimulatedGBM", &SimulatedGBM, "Simulate paths for Geometric Brownian Motion and calculate the average final price",
         py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"));
+    m.def("SimulateGBMMultiThreaded",&SimulateGBMMultiThreadedBinding,"Simulate Paths for GBM using multiple threads, collectCounters adds a dict of hardware counters to the result",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"), py::arg("numThreads") = 0,
+        py::arg("collectCounters") = false);
+    m.def("SimulateGBMIntrinsicMT",&SimulateGBMIntrinsicMTBinding,"Using SIMD instructions, collectCounters adds a dict of hardware counters to the result",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"), py::arg("numThreads") = 0,
+        py::arg("collectCounters") = false);
+    m.def("LoadPriceHistory",&LoadPriceHistory,"Load Date/Close columns from a CSV through a memory mapped binary cache, returns (epoch seconds, closes)",
+        py::arg("filePath"));
+    m.def("LoadPricePanel",&LoadPricePanel,"Load every CSV in a directory in parallel and align the closes on a common date index",
+        py::arg("directory"), py::arg("numThreads") = 0);
+    m.def("CalculatePanelStatistics",&CalculatePanelStatistics,"CalculateStatistics for every ticker of a panel over [startDate, endDate) given as epoch seconds",
+        py::arg("dates"), py::arg("closes"), py::arg("startDate"), py::arg("endDate"), py::arg("steps"), py::arg("numThreads") = 0);
+    m.def("SimulateGBMBatch",&SimulateGBMBatch,"Average simulated final price for each ticker using the SIMD engine",
+        py::arg("startingPrices"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"), py::arg("numThreads") = 0);
+    m.def("CalculateCorrelationMatrix",&CalculateCorrelationMatrix,"Pairwise complete covariance and correlation of a (dates x tickers) log return panel, returns (covariance, correlation)",
+        py::arg("logReturns"), py::arg("mask") = py::none(), py::arg("shrinkage") = 0.0, py::arg("numThreads") = 0);
+    m.def("BootstrapStatistics",&BootstrapStatistics,"Block bootstrap distribution of the CalculateStatistics values, blockLength 0 picks n^(1/3), seed 0 draws a random seed",
+        py::arg("logReturns"), py::arg("steps"), py::arg("resamples") = 1000, py::arg("blockLength") = 0, py::arg("seed") = 0, py::arg("numThreads") = 0);
+    m.def("ScoreForecast",&ScoreForecast,"CRPS, pinball losses and interval coverage of the simulated final price against the realised price",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"),
+        py::arg("realPrice"), py::arg("quantiles") = std::vector<double>{0.05, 0.25, 0.5, 0.75, 0.95},
+        py::arg("intervals") = std::vector<double>{0.5, 0.8, 0.9, 0.95}, py::arg("bins") = 4096, py::arg("numThreads") = 0);
+    m.def("SimulateGBMInterleavedMT",&SimulateGBMInterleavedMT,"SIMD engine with several independent groups of 4 paths in flight per thread",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"), py::arg("streams") = 4, py::arg("numThreads") = 0);
+    m.def("BenchmarkSIMDKernels",&BenchmarkSIMDKernels,"Single thread timing and FLOP/cycle of the SIMD kernels",
+        py::arg("steps") = 252, py::arg("paths") = 100000, py::arg("repeats") = 3, py::arg("blockSizes") = std::vector<int>{16, 64, 128, 256, 1024});
+    m.def("SimulateGBMBlockRNGMT",&SimulateGBMBlockRNGMT,"SIMD engine that generates normals in L1 sized tiles before the price update, blockSteps 0 uses the current default",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"), py::arg("blockSteps") = 0, py::arg("numThreads") = 0);
+    m.def("AvailableThreadCount",&AvailableThreadCount,"CPUs usable by this process after affinity and cgroup quota, the default for numThreads = 0");
+    m.def("Autotune",&Autotune,"Benchmark kernels, thread counts and chunk sizes on this machine and save the best as the default profile",
+        py::arg("profilePath") = "", py::arg("steps") = 252, py::arg("paths") = 50000);
+    m.def("GetTuningProfile",&GetTuningProfile,"The tuning profile the default entry points use, None when there is none for this machine");
+    m.def("LoadTuningProfile",&LoadTuningProfile,"Load a tuning profile, returns False when it is missing or was made on another machine",
+        py::arg("profilePath") = "");
+    m.def("SimulateGBMCounterRNGMT",&SimulateGBMCounterRNGMTBinding,"Counter based RNG engine returning (displayPaths, average, seed), display paths are replays of the paths at evenly spaced terminal quantiles",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"),
+        py::arg("seed") = 0, py::arg("displayPaths") = 50, py::arg("numThreads") = 0);
+    m.def("FindQuantilePaths",&FindQuantilePaths,"Indices of the paths whose terminal prices sit at the given quantiles, in one pass without storing paths",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"),
+        py::arg("seed"), py::arg("quantiles"), py::arg("bins") = 2048, py::arg("numThreads") = 0);
+    m.def("ReplayPaths",&ReplayPaths,"Regenerate the given paths of a counter based RNG run as a len(pathIndices) x steps array",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"),
+        py::arg("seed"), py::arg("pathIndices"));
+    m.def("PriceCallAdjoint",&PriceCallAdjoint,"European call price with delta, strike, rate and per step drift/vol sensitivities from one adjoint pass",
+        py::arg("startingPrice"), py::arg("strike"), py::arg("rate"), py::arg("drifts"), py::arg("vols"), py::arg("paths"),
+        py::arg("seed") = 0, py::arg("numThreads") = 0);
+    m.def("SimulateHedgePnL",&SimulateHedgePnL,"P&L distribution of a short call delta hedged every rebalanceSteps steps with proportional costs, hedgeVol 0 uses normalizedStd",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"),
+        py::arg("strike"), py::arg("rate") = 0.0, py::arg("hedgeVol") = 0.0, py::arg("rebalanceSteps") = 1, py::arg("costRate") = 0.0,
+        py::arg("bins") = 4096, py::arg("numThreads") = 0);
+    m.def("BacktestRebalancing",&BacktestRebalancing,"Terminal wealth, drawdown and turnover of buy-and-hold, constant-mix and threshold rebalancing on correlated paths",
+        py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("correlation"), py::arg("targetWeights"),
+        py::arg("steps"), py::arg("paths"), py::arg("rebalanceSteps") = 21, py::arg("band") = 0.05, py::arg("costRate") = 0.0,
+        py::arg("bins") = 4096, py::arg("numThreads") = 0);
+    m.def("SimulateGBMStudentTMT",&SimulateGBMStudentTMT,"SIMD engine with unit variance Student-t step innovations",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"),
+        py::arg("degreesOfFreedom"), py::arg("numThreads") = 0);
+    m.def("SimulateGBMNIGMT",&SimulateGBMNIGMT,"SIMD engine with unit variance Normal-Inverse-Gaussian step innovations of the given shape",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"),
+        py::arg("alpha"), py::arg("beta"), py::arg("delta"), py::arg("numThreads") = 0);
+    m.def("FitStudentT",&FitStudentT,"Integer degrees of freedom maximising the Student-t likelihood of the log returns",py::arg("logReturns"));
+    m.def("FitNIG",&FitNIG,"Normal-Inverse-Gaussian parameters of the log returns by the method of moments",py::arg("logReturns"));
+    m.def("SimulateVarianceGammaMT",&SimulateVarianceGammaMT,"Variance-Gamma engine, gamma time changes and conditional normals sampled exactly per lane and step",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("sigma"), py::arg("theta"), py::arg("nu"), py::arg("steps"), py::arg("paths"),
+        py::arg("numThreads") = 0);
+    m.def("SimulateOUMT",&SimulateOUMT,"Ornstein-Uhlenbeck engine with exact steps, exponential simulates log prices as OU",
+        py::arg("startingValue"), py::arg("kappa"), py::arg("theta"), py::arg("sigma"), py::arg("steps"), py::arg("paths"),
+        py::arg("exponential") = false, py::arg("numThreads") = 0);
+    m.def("CalibrateOU",&CalibrateOU,"OU kappa/theta/sigma of the CSV closes (or log closes) dated in [startDate, endDate) by AR(1) regression",
+        py::arg("filePath"), py::arg("startDate"), py::arg("endDate"), py::arg("steps"), py::arg("exponential") = false);
+    m.def("SimulateGBMStochasticRatesMT",&SimulateGBMStochasticRatesMT,"GBM drifting at a CIR or Vasicek short rate, discounted bond, asset and option values from one pass",
+        py::arg("startingPrice"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths"), py::arg("rateModel"),
+        py::arg("startingRate"), py::arg("kappa"), py::arg("theta"), py::arg("rateSigma"), py::arg("correlation") = 0.0, py::arg("premium") = 0.0,
+        py::arg("strike") = 0.0, py::arg("numThreads") = 0);
+    m.def("SimulateLocalVolMT",&SimulateLocalVolMT,"Engine with vol(t, S) from a (times x spots) local vol grid, resampled to nodes log spaced spots per step",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("times"), py::arg("spots"), py::arg("vols"), py::arg("steps"), py::arg("paths"),
+        py::arg("nodes") = 512, py::arg("numThreads") = 0);
+    m.def("CarrMadanPrices",&CarrMadanPrices,"Carr-Madan FFT call and put prices; parameters: gbm (sigma), heston (v0, kappa, theta, sigmaV, rho), varianceGamma (sigma, theta, nu)",
+        py::arg("model"), py::arg("parameters"), py::arg("startingPrice"), py::arg("rate"), py::arg("maturity"), py::arg("strikes"),
+        py::arg("alpha") = 1.5, py::arg("points") = 4096, py::arg("eta") = 0.25);
+    m.def("CrossCheckCarrMadan",&CrossCheckCarrMadan,"Carr-Madan prices against a Monte Carlo run of the same model, with z scores",
+        py::arg("model"), py::arg("parameters"), py::arg("startingPrice"), py::arg("rate"), py::arg("maturity"), py::arg("strikes"),
+        py::arg("steps") = 252, py::arg("paths") = 200000, py::arg("numThreads") = 0);
+    m.def("SolveCrankNicolson",&SolveCrankNicolson,"Crank-Nicolson GBM prices, deltas and gammas per strike plus the density of ln S_T on the grid",
+        py::arg("startingPrice"), py::arg("rate"), py::arg("sigma"), py::arg("maturity"), py::arg("strikes"), py::arg("optionType") = "call",
+        py::arg("exercise") = "european", py::arg("barrierType") = "none", py::arg("barrier") = 0.0, py::arg("spotNodes") = 512, py::arg("timeSteps") = 256);
+    m.def("PriceLattice",&PriceLattice,"Binomial or trinomial lattice price with optional early exercise and Richardson extrapolation between steps and steps / 2",
+        py::arg("startingPrice"), py::arg("rate"), py::arg("sigma"), py::arg("maturity"), py::arg("strike"), py::arg("optionType") = "put",
+        py::arg("exercise") = "american", py::arg("lattice") = "binomial", py::arg("steps") = 1000, py::arg("richardson") = true);
+    m.def("SimulateLongPathsMT",&SimulateLongPathsMT,"Few very long GBM paths built in parallel over time by a blocked prefix sum, sampled at samplePoints evenly spaced steps",
+        py::arg("startingPrice"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("steps"), py::arg("paths") = 1,
+        py::arg("samplePoints") = 1000, py::arg("seed") = 0, py::arg("numThreads") = 0);
+    m.def("FitFactorModel",&FitFactorModel,"Truncated PCA of a (dates x tickers) log return panel, returns loadings (tickers x factors) in correlation units and idiosyncratic variances",
+        py::arg("logReturns"), py::arg("factors"), py::arg("iterations") = 10, py::arg("numThreads") = 0);
+    m.def("SimulateFactorModelMT",&SimulateFactorModelMT,"Average simulated final price per ticker with shocks correlated through a factor model, O(tickers x factors) per step",
+        py::arg("startingPrices"), py::arg("normalizedMu"), py::arg("normalizedVar"), py::arg("normalizedStd"), py::arg("loadings"),
+        py::arg("idiosyncraticVariance"), py::arg("steps"), py::arg("paths"), py::arg("numThreads") = 0);
+    m.def("EnableTracing",[](size_t eventsPerThread){ Tracer::Instance().Enable(eventsPerThread); },"Start recording engine phases into per thread ring buffers",
+        py::arg("eventsPerThread") = 1 << 16);
+    m.def("DisableTracing",[](){ Tracer::Instance().Disable(); },"Stop recording engine phases, recorded events are kept");
+    m.def("DumpTrace",[](const std::string& path){ return Tracer::Instance().Dump(path); },"Write the recorded events as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)",
+        py::arg("path"));
+    m.def("SetRNGBlockSteps",[](int blockSteps){ rngBlockSteps = std::max(1, blockSteps); },"Set the default number of steps per RNG tile",
+        py::arg("blockSteps"));
 }
\ No newline at end of file
@@ -64,6 +64,7 @@ class GBMApp:
         self.m_EndDate = ""
         self.m_Steps = ""
         self.m_Paths = 100_000_000
+        self.m_ScoringPaths = 1_000_000
         self.SetupLayout()
 
     def SetupLayout(self):
@@ -223,10 +224,11 @@ class GBMApp:
         print(f"C++ MultiThreaded version took {end_time - start_time:.4f} seconds.")
 
 
+        #counter RNG engine: SIMD like the Intrinsic one, and its display paths are replays at evenly spaced terminal quantiles
         start_time = time.perf_counter()
-        walks, averagePrice = simulation.SimulateGBMIntrinsicMT(startingPrice,stats.normalizedMu,stats.normalizedVariance,stats.normalizedDeviation,int(self.m_Steps),self.m_Paths)
+        walks, averagePrice, seed = simulation.SimulateGBMCounterRNGMT(startingPrice,stats.normalizedMu,stats.normalizedVariance,stats.normalizedDeviation,int(self.m_Steps),self.m_Paths)
         end_time = time.perf_counter()
-        print(f"C++ MultiThreaded Intrinsic version took {end_time - start_time:.4f} seconds.")
+        print(f"C++ MultiThreaded counter RNG version took {end_time - start_time:.4f} seconds.")
         npPaths = np.array(walks)
         self.plotGBM(npPaths, self.m_EndDate)
 
@@ -234,6 +236,13 @@ class GBMApp:
         print(realPrice)
         print(averagePrice/realPrice)
 
+        scores = simulation.ScoreForecast(startingPrice,stats.normalizedMu,stats.normalizedVariance,stats.normalizedDeviation,int(self.m_Steps),self.m_ScoringPaths,realPrice)
+        print(f"CRPS: {scores['crps']:.4f} PIT: {scores['pit']:.3f}")
+        for q, loss in zip(scores['quantiles'], scores['pinballLosses']):
+            print(f"Pinball loss q={q}: {loss:.4f}")
+        for level, covered, width in zip(scores['intervals'], scores['intervalCoverage'], scores['intervalWidths']):
+            print(f"{int(level*100)}% interval covered: {bool(covered)} width: {width:.4f}")
+
 
 
 def main():
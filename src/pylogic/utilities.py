@@ -1,16 +1,15 @@
 import pandas as pd
 import numpy as np
+import simulation
 
 def ReadCsvData(filePath):
-    if VerifyCsvFormat(filePath):     
-        data = pd.read_csv(filePath)
+    if VerifyCsvFormat(filePath):
+        # parsed once into <file>.gbmcache, later loads memory map the cache
+        dates, closes = simulation.LoadPriceHistory(filePath)
         data = pd.DataFrame({
-            "Date": data["Date"],
-            "Close": data["Close"]
+            "Date": pd.to_datetime(dates, unit='s'),
+            "Close": closes
         })
-        data['Date'] = pd.to_datetime(data['Date'])
-        data.sort_values(by='Date',ascending=True, inplace=True)
-        data.reset_index(drop=True, inplace=True)
         return data
     else:
         return None
@@ -103,3 +102,71 @@ def GBM(startingPrice, normalizedMu, normalizedVar, normalizedDev, steps, paths)
     return displayPaths, averagePredictedPrice
 
 
+
+def ReadCsvPanel(directoryPath):
+    # every CSV in the directory, closes aligned on the union of their dates (NaN where missing)
+    panel = simulation.LoadPricePanel(directoryPath)
+    panel['dates'] = pd.to_datetime(panel['dates'], unit='s')
+    return panel
+
+def CalculatePanelStatistics(panel, startDate, endDate, steps):
+    startSeconds = pd.to_datetime(startDate).value // 10**9
+    endSeconds = pd.to_datetime(endDate).value // 10**9
+    dates = panel['dates'].values.astype('datetime64[s]').astype(np.int64)
+    return simulation.CalculatePanelStatistics(dates, panel['closes'], startSeconds, endSeconds, int(steps))
+
+def SimulatePanel(panelStats, steps, paths):
+    return simulation.SimulateGBMBatch(panelStats['startingPrice'], panelStats['normalizedMu'], panelStats['normalizedVariance'],
+                                       panelStats['normalizedDeviation'], int(steps), paths)
+
+def PanelLogReturns(panel):
+    # NaN wherever a ticker is missing either close, the correlation kernel skips those dates per pair
+    return np.diff(np.log(panel['closes']), axis=0)
+
+def CalculatePanelCorrelation(panel, shrinkage=0.0):
+    return simulation.CalculateCorrelationMatrix(PanelLogReturns(panel), shrinkage=shrinkage)
+
+def TrainingLogReturns(data, startDate, endDate):
+    startIndex = data.index[data['Date'] == startDate][0]
+    endIndex = data.index[data['Date']==endDate][0]
+    trainingData = data.iloc[startIndex:endIndex]
+    logReturns = np.log(trainingData['Close']) - np.log(trainingData['Close'].shift(1))
+    return logReturns.to_numpy()
+
+def BootstrapForecast(data, startDate, endDate, steps, paths, resamples=1000, blockLength=0):
+    # one simulation per bootstrapped (mu, sigma), the spread of the averages reflects estimation error
+    logReturns = TrainingLogReturns(data, startDate, endDate)
+    stats = simulation.BootstrapStatistics(logReturns, int(steps), resamples, blockLength)
+    startIndex = data.index[data['Date'] == endDate][0]
+    startingPrice = data.loc[startIndex - 1, 'Close']
+    averagePrices = simulation.SimulateGBMBatch(np.full(resamples, startingPrice), stats['normalizedMu'], stats['normalizedVariance'],
+                                                stats['normalizedDeviation'], int(steps), max(4, paths // resamples))
+    return stats, averagePrices
+
+def FitInnovations(data, startDate, endDate):
+    # heavy tailed shock shapes for SimulateGBMStudentTMT / SimulateGBMNIGMT from the training window
+    logReturns = TrainingLogReturns(data, startDate, endDate)
+    return simulation.FitStudentT(logReturns), simulation.FitNIG(logReturns)
+
+def CalibrateOU(filePath, startDate, endDate, steps, exponential=False):
+    # kappa/theta/sigma per observation plus the per horizon values SimulateOUMT takes
+    startSeconds = pd.to_datetime(startDate).value // 10**9
+    endSeconds = pd.to_datetime(endDate).value // 10**9
+    return simulation.CalibrateOU(filePath, startSeconds, endSeconds, int(steps), exponential)
+
+def PriceLatticeOption(stats, steps, startingPrice, strike, rate, optionType='put', exercise='american', lattice='binomial', latticeSteps=1000):
+    # the option runs over one forecast horizon of steps observations; normalizedDeviation is sqrt(trainingDeviation),
+    # not a horizon volatility, so sigma is the per observation deviation scaled by sqrt(steps)
+    sigma = stats.trainingDeviation * np.sqrt(int(steps))
+    return simulation.PriceLattice(startingPrice, rate, sigma, 1.0, strike, optionType, exercise, lattice, int(latticeSteps))
+
+def SimulatePanelFactorModel(panel, panelStats, startDate, endDate, steps, paths, factors=5):
+    # correlated panel simulation for large universes, the factor model is fitted on the aligned returns of the
+    # same [startDate, endDate) window panelStats was computed over so no forecast horizon returns leak in
+    dates = pd.DatetimeIndex(panel['dates'])
+    window = (dates >= pd.to_datetime(startDate)) & (dates < pd.to_datetime(endDate))
+    trainingPanel = {'dates': dates[window], 'closes': panel['closes'][window]}
+    model = simulation.FitFactorModel(PanelLogReturns(trainingPanel), int(factors))
+    averagePrices = simulation.SimulateFactorModelMT(panelStats['startingPrice'], panelStats['normalizedMu'], panelStats['normalizedVariance'],
+                                                     panelStats['normalizedDeviation'], model['loadings'], model['idiosyncraticVariance'], int(steps), paths)
+    return averagePrices, model